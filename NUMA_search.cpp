@@ -0,0 +1,61 @@
+#include <iostream>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+#include "utils/numa.hpp"
+
+#include <omp.h>
+
+int main(){
+    // Base rows are sharded over the NUMA nodes, huge-page backed
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs", NUMA_SHARD);
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+    const NumaShards& shards = base.get_shards();
+
+    int k = 100;
+    int num_clusters = 20;
+    int knn_cluster = 2; // should be 10% - 25% of num_clusters
+
+    ANNS ann(base_dim, k, query_data, base_data, query_size, base_size);
+
+    // Brute force, node-local scans
+    ann.brute_knn_numa(shards);
+    auto brute_time = ann.get_runtime();
+    Recall brute_recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+
+    // IVF, node-local halves of every probed list
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    const float* clusters = kmeans.get_clusters();
+
+    ann.IVF_knn_numa(clusters, ivf, num_clusters, knn_cluster, shards);
+    auto ivf_time = ann.get_runtime();
+    Recall ivf_recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+
+    int num_threads = 0;
+    #pragma omp parallel
+    {
+        #pragma omp single
+        num_threads = omp_get_num_threads();
+    }
+    std::cout << "OpenMP NUMA ANN search (" << num_threads << " threads, "
+              << shards.get_num_shards() << " nodes)\n";
+
+    std::cout << "Brute search time: " << brute_time << "ms" << std::endl;
+    std::cout << "Brute recall: " << brute_recall.get_recall() << std::endl;
+    std::cout << "IVF build time: " << kmeans.get_build_time() << "ms" << std::endl;
+    std::cout << "IVF search time: " << ivf_time << "ms" << std::endl;
+    std::cout << "IVF recall: " << ivf_recall.get_recall() << std::endl;
+}
@@ -0,0 +1,219 @@
+#include <iostream>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <link.h>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/binary.hpp"
+#include "utils/imi.hpp"
+#include "utils/numa.hpp"
+#include "utils/rerank.hpp"
+#include "utils/diskann.hpp"
+
+#include <omp.h>
+
+// Every call into the malloc family bumps this while counting is on. The
+// glibc entry points are wrapped, so operator new, aligned_alloc and
+// posix_memalign from any library are all seen. Calls made by the OpenMP
+// runtime itself are left out: libgomp allocates a team descriptor for some
+// parallel regions (single thread teams after a nested region), which no
+// search code can avoid.
+static std::atomic<long> num_allocs(0);
+static std::atomic<bool> counting(false);
+static uintptr_t runtime_begin = 0, runtime_end = 0;
+
+static int find_runtime(dl_phdr_info* info, size_t, void*) {
+    if (!info->dlpi_name || !strstr(info->dlpi_name, "libgomp")) return 0;
+    for (int h = 0; h < info->dlpi_phnum; ++h) {
+        const ElfW(Phdr)& phdr = info->dlpi_phdr[h];
+        if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_X)) continue;
+        runtime_begin = info->dlpi_addr + phdr.p_vaddr;
+        runtime_end = runtime_begin + phdr.p_memsz;
+    }
+    return 1;
+}
+
+static inline void count_alloc(void* caller) {
+    if (!counting.load(std::memory_order_relaxed)) return;
+    uintptr_t addr = reinterpret_cast<uintptr_t>(caller);
+    if (addr >= runtime_begin && addr < runtime_end) return;
+    num_allocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) noexcept {
+    count_alloc(__builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) noexcept {
+    count_alloc(__builtin_return_address(0));
+    return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+    count_alloc(__builtin_return_address(0));
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    count_alloc(__builtin_return_address(0));
+    return __libc_memalign(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+    count_alloc(__builtin_return_address(0));
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept {
+    count_alloc(__builtin_return_address(0));
+    void* mem = __libc_memalign(alignment, size);
+    if (!mem) return ENOMEM;
+    *ptr = mem;
+    return 0;
+}
+
+void free(void* ptr) noexcept {
+    __libc_free(ptr);
+}
+}
+
+// Warms every thread's SearchContext with warm() (nested regions are serial,
+// so each team thread runs a whole search), then runs batch() once
+// unmeasured and once with counting on. The search paths must not allocate
+// once warm.
+template <typename Warm, typename Batch>
+bool check(const char* name, Warm warm, Batch batch) {
+    #pragma omp parallel
+    {
+        warm();
+    }
+    batch();
+
+    num_allocs = 0;
+    counting = true;
+    batch();
+    counting = false;
+    long count = num_allocs;
+    std::cout << name << ": " << count << " allocations" << std::endl;
+    return count == 0;
+}
+
+int main(){
+    dl_iterate_phdr(find_runtime, nullptr);
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+
+    int base_dim = base.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+
+    int k = 100;
+    int R = 200;
+    int num_clusters = 20;
+    int knn_cluster = 2;
+    int imi_k = 16;
+    int max_candidates = 1000;
+
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    const float* clusters = kmeans.get_clusters();
+
+    BinaryQuantizer quantizer(base_dim);
+    quantizer.train(base_data, base_size);
+    BinaryCodes codes(quantizer, base_data, base_size);
+
+    InvertedMultiIndex imi(base_dim, imi_k);
+    if (!imi.build(base_data, base_size)) return 1;
+
+    search_budget_t budget;
+    budget.deadline_us = 1e9;
+    budget.max_distances = 0;
+
+    // same rows placed node by node, for the NUMA paths
+    GraphData<float> numa_base("data/siftsmall/siftsmall_base.fvecs", NUMA_SHARD);
+    float* numa_data = numa_base.get_data();
+    const NumaShards& shards = numa_base.get_shards();
+
+    vamana_params_t params;
+    params.max_degree = 32;
+    params.build_L = 64;
+    std::string index_file = "data/siftsmall/alloc_test.index";
+    if (!DiskIndex::build(index_file, "data/siftsmall/siftsmall_base.fvecs", params)) return 1;
+    DiskIndex index(index_file);
+    Reranker reranker("data/siftsmall/siftsmall_base.fvecs");
+    if (!index.ok() || !reranker.ok()) return 1;
+
+    ANNS ann(base_dim, k, query_data, base_data, query_size, base_size);
+    ANNS numa_ann(base_dim, k, query_data, numa_data, query_size, base_size);
+
+    ANNS wide(base_dim, R, query_data, base_data, query_size, base_size);
+    wide.IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+    const int* candidates = wide.get_dist_lists();
+    std::vector<int> results(static_cast<size_t>(query_size) * k);
+
+    int num_threads = 0;
+    #pragma omp parallel
+    {
+        #pragma omp single
+        num_threads = omp_get_num_threads();
+    }
+    std::cout << "Steady state allocation check (" << num_threads << " threads)\n";
+
+    omp_set_max_active_levels(1);
+    // ANNS paths warm on a one query ANNS of each thread's own
+    auto run = [&](const char* name, auto search) {
+        return check(name, [&]() {
+            ANNS one(base_dim, k, query_data, base_data, 1, base_size);
+            search(one);
+        }, [&]() { search(ann); });
+    };
+    auto run_numa = [&](const char* name, auto search) {
+        return check(name, [&]() {
+            ANNS one(base_dim, k, query_data, numa_data, 1, base_size);
+            search(one);
+        }, [&]() { search(numa_ann); });
+    };
+
+    bool ok = true;
+    ok &= run("brute_knn", [&](ANNS& a) { a.brute_knn(); });
+    ok &= run("IVF_knn", [&](ANNS& a) { a.IVF_knn(clusters, ivf, num_clusters, knn_cluster); });
+    ok &= run("IVF_knn_bounded", [&](ANNS& a) { a.IVF_knn_bounded(clusters, ivf, num_clusters, knn_cluster, budget); });
+    ok &= run("brute_knn_binary", [&](ANNS& a) { a.brute_knn_binary(quantizer, codes, R); });
+    ok &= run("IVF_knn_binary", [&](ANNS& a) { a.IVF_knn_binary(clusters, ivf, num_clusters, knn_cluster, quantizer, codes, R); });
+    ok &= run("IMI_knn", [&](ANNS& a) { a.IMI_knn(imi, max_candidates); });
+    ok &= run("IVF_knn_scheduled", [&](ANNS& a) { a.IVF_knn_scheduled(clusters, ivf, num_clusters, knn_cluster); });
+    ok &= run_numa("brute_knn_numa", [&](ANNS& a) { a.brute_knn_numa(shards); });
+    ok &= run_numa("IVF_knn_numa", [&](ANNS& a) { a.IVF_knn_numa(clusters, ivf, num_clusters, knn_cluster, shards); });
+    ok &= check("Reranker::rerank", [&]() {
+        std::vector<int> one(k);
+        reranker.rerank(query_data, base_dim, 1, candidates, R, k, one.data());
+    }, [&]() { reranker.rerank(query_data, base_dim, query_size, candidates, R, k, results.data()); });
+    ok &= check("DiskIndex::search", [&]() {
+        std::vector<int> one(k);
+        index.search(query_data, 1, k, 250, 4, one.data());
+    }, [&]() { index.search(query_data, query_size, k, 250, 4, results.data()); });
+    std::remove(index_file.c_str());
+
+    if (!ok) {
+        std::cerr << "Search allocated after warm-up" << std::endl;
+        return 1;
+    }
+    std::cout << "No allocations after warm-up" << std::endl;
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <vector>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+#include "utils/autotune.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    double target = 0.95;
+
+    // First half of the queries tunes, the second half checks the pick
+    int tune_size = query_size / 2;
+    int check_size = query_size - tune_size;
+    const float* check_data = query_data + static_cast<size_t>(tune_size) * base_dim;
+    const int* check_gt = gt_data + static_cast<size_t>(tune_size) * gt_dim;
+
+    IVFAutotuner tuner(base_dim, k, base_data, base_size, query_data, tune_size);
+    tuner.tune(target, {10, 20, 40, 80});
+
+    std::cout << "num_clusters knn_cluster recall latency_us" << std::endl;
+    for (const tune_point_t& p : tuner.get_curve()) {
+        std::cout << p.num_clusters << " " << p.knn_cluster << " " << p.recall << " " << p.latency_us << std::endl;
+    }
+    std::cout << "Pareto front:" << std::endl;
+    for (const tune_point_t& p : tuner.get_pareto()) {
+        std::cout << p.num_clusters << " " << p.knn_cluster << " " << p.recall << " " << p.latency_us << std::endl;
+    }
+
+    if (!tuner.has_best()) {
+        std::cout << "No configuration reaches recall " << target << std::endl;
+        return 1;
+    }
+    tune_point_t best = tuner.get_best();
+    std::cout << "Fastest for recall " << target << ": num_clusters " << best.num_clusters
+              << ", knn_cluster " << best.knn_cluster << " (" << best.latency_us << " us/query)" << std::endl;
+
+    KMeans kmeans(best.num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    ANNS ann(base_dim, k, check_data, base_data, check_size, base_size);
+    ann.IVF_knn(kmeans.get_clusters(), ivf, best.num_clusters, best.knn_cluster);
+    Recall recall(check_gt, base_data, check_data, ann.get_dist_lists(), base_dim, check_size, gt_dim, k);
+    std::cout << "Held-out recall: " << recall.get_recall() << std::endl;
+}
@@ -0,0 +1,61 @@
+#include <iostream>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+#include "utils/binary.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int R = 200; // Hamming candidates re-scored per query
+    int num_clusters = 20;
+    int knn_cluster = 2; // should be 10% - 25% of num_clusters
+
+    BinaryQuantizer quantizer(base_dim);
+    quantizer.train(base_data, base_size);
+    BinaryCodes codes(quantizer, base_data, base_size);
+
+    ANNS ann(base_dim, k, query_data, base_data, query_size, base_size);
+
+    ann.brute_knn_binary(quantizer, codes, R);
+    auto brute_time = ann.get_runtime();
+    Recall brute_recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    const float* clusters = kmeans.get_clusters();
+
+    ann.IVF_knn_binary(clusters, ivf, num_clusters, knn_cluster, quantizer, codes, R);
+    auto ivf_time = ann.get_runtime();
+    Recall ivf_recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+
+    int num_threads = 0;
+    #pragma omp parallel
+    {
+        #pragma omp single
+        num_threads = omp_get_num_threads();
+    }
+    std::cout << "OpenMP binary prefilter ANN search (" << num_threads << " threads, R = " << R << ")\n";
+
+    std::cout << "Code size: " << codes.get_bytes() / 1024 << " KB" << std::endl;
+    std::cout << "Brute search time: " << brute_time << "ms" << std::endl;
+    std::cout << "Brute recall: " << brute_recall.get_recall() << std::endl;
+    std::cout << "IVF search time: " << ivf_time << "ms" << std::endl;
+    std::cout << "IVF recall: " << ivf_recall.get_recall() << std::endl;
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int num_clusters = 20;
+    int knn_cluster = 4; // should be 10% - 25% of num_clusters
+
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    const float* clusters = kmeans.get_clusters();
+
+    ANNS ann(base_dim, k, query_data, base_data, query_size, base_size);
+
+    ann.IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+    Recall full_recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+    std::cout << "Unbounded: " << ann.get_runtime() << "ms, recall " << full_recall.get_recall() << std::endl;
+
+    // Distance budgets
+    for (long max_distances : {10L, 500L, 1000L, 2000L}) {
+        search_budget_t budget;
+        budget.max_distances = max_distances;
+        ann.IVF_knn_bounded(clusters, ivf, num_clusters, knn_cluster, budget);
+        Recall recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+        std::cout << "Budget " << max_distances << " distances: " << ann.get_runtime() << "ms, recall "
+                  << recall.get_recall() << ", " << ann.get_num_incomplete() << "/" << query_size << " cut short" << std::endl;
+    }
+
+    // Per query latency deadlines
+    for (double deadline_us : {50.0, 200.0, 1000.0}) {
+        search_budget_t budget;
+        budget.deadline_us = deadline_us;
+        ann.IVF_knn_bounded(clusters, ivf, num_clusters, knn_cluster, budget);
+        Recall recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+        std::cout << "Deadline " << deadline_us << "us: " << ann.get_runtime() << "ms, recall "
+                  << recall.get_recall() << ", " << ann.get_num_incomplete() << "/" << query_size << " cut short" << std::endl;
+    }
+}
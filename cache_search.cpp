@@ -0,0 +1,78 @@
+#include <iostream>
+#include <random>
+#include <cstring>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+#include "utils/query_cache.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+
+    int base_dim = base.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+
+    int k = 100;
+    int num_clusters = 20;
+    int knn_cluster = 2; // should be 10% - 25% of num_clusters
+
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    const float* clusters = kmeans.get_clusters();
+
+    // Traffic: every query once, then exact repeats, then slightly perturbed repeats
+    int passes = 3;
+    int traffic_size = query_size * passes;
+    float* traffic = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(traffic_size) * base_dim * sizeof(float)));
+    std::mt19937 gen(42);
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+    for (int p = 0; p < passes; ++p) {
+        float* dst = traffic + static_cast<size_t>(p) * query_size * base_dim;
+        std::memcpy(dst, query_data, static_cast<size_t>(query_size) * base_dim * sizeof(float));
+        if (p == 2) {
+            for (size_t j = 0; j < static_cast<size_t>(query_size) * base_dim; ++j) dst[j] += noise(gen);
+        }
+    }
+
+    QueryCache cache(base_dim, k, 4096, 1.0f, 50.0f);
+    cache.train(base_data, base_size);
+
+    ANNS uncached(base_dim, k, traffic, base_data, traffic_size, base_size);
+    uncached.IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+
+    ANNS ann(base_dim, k, traffic, base_data, traffic_size, base_size);
+    ann.IVF_knn_cached(cache, clusters, ivf, num_clusters, knn_cluster);
+
+    // Agreement with the uncached answers, near-duplicate hits may differ slightly
+    Recall agreement(uncached.get_dist_lists(), base_data, traffic, ann.get_dist_lists(), base_dim, traffic_size, k, k);
+
+    std::cout << "IVF search with result cache (" << traffic_size << " queries)\n";
+    std::cout << "Uncached search time: " << uncached.get_runtime() << "ms" << std::endl;
+    std::cout << "Cached search time: " << ann.get_runtime() << "ms" << std::endl;
+    std::cout << "Hit rate: " << cache.get_hit_rate() << " (" << cache.get_exact_hits() << " exact, "
+              << cache.get_near_hits() << " near)" << std::endl;
+    std::cout << "Saved search time: " << cache.get_saved_ms() << "ms" << std::endl;
+    std::cout << "Agreement with uncached: " << agreement.get_recall() << std::endl;
+
+    // Entries are keyed by nprobe too, so a different knn_cluster doesn't reuse them
+    uint64_t misses_probe = cache.get_misses();
+    ann.IVF_knn_cached(cache, clusters, ivf, num_clusters, knn_cluster + 1);
+    std::cout << "Misses with knn_cluster " << knn_cluster + 1 << ": " << cache.get_misses() - misses_probe << std::endl;
+
+    // An index update retires every entry, so the first pass misses again
+    uint64_t misses_before = cache.get_misses();
+    cache.invalidate();
+    ann.IVF_knn_cached(cache, clusters, ivf, num_clusters, knn_cluster);
+    std::cout << "Misses after invalidate: " << cache.get_misses() - misses_before << std::endl;
+
+    free(traffic);
+}
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <vector>
+#include "utils/distance.hpp"
+#include "utils/data.hpp"
+#include "utils/recall.hpp"
+#include "utils/diskann.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int L = 250;    // candidate list size, >= k
+    int W = 4;      // parallel sector reads per hop
+
+    vamana_params_t params;
+    params.max_degree = 32;
+    params.build_L = 64;
+    params.memory_budget_mb = 4; // forces a partitioned build on siftsmall
+
+    std::string index_file = "data/siftsmall/siftsmall_disk.index";
+    // built straight from the .fvecs file, within memory_budget_mb
+    if (!DiskIndex::build(index_file, "data/siftsmall/siftsmall_base.fvecs", params)) return 1;
+
+    DiskIndex index(index_file);
+    if (!index.ok()) return 1;
+    std::vector<int> results(static_cast<size_t>(query_size) * k);
+    index.search(query_data, query_size, k, L, W, results.data());
+    auto search_time = index.get_runtime();
+
+    Recall recall(gt_data, base_data, query_data, results.data(), base_dim, query_size, gt_dim, k);
+
+    int num_threads = 0;
+    #pragma omp parallel
+    {
+        #pragma omp single
+        num_threads = omp_get_num_threads();
+    }
+    std::cout << "OpenMP disk ANN search (" << num_threads << " threads, L = " << L << ", W = " << W << ")\n";
+
+    std::cout << "In-memory index: " << index.get_memory_bytes() / 1024 << " KB" << std::endl;
+    std::cout << "Search time: " << search_time << "ms" << std::endl;
+    std::cout << "Latency: " << search_time / query_size << " ms/query" << std::endl;
+    std::cout << "Mean I/Os: " << index.get_mean_ios() << " sectors/query" << std::endl;
+    std::cout << "Mean hops: " << index.get_mean_hops() << std::endl;
+    std::cout << "Recall: " << recall.get_recall() << std::endl;
+}
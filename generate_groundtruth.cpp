@@ -0,0 +1,45 @@
+#include <iostream>
+#include "utils/data.hpp"
+#include "utils/recall.hpp"
+#include "utils/groundtruth.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int query_dim = query.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    float* query_data = query.get_data();
+
+    int k = 100;
+    int chunk_rows = 1000;
+    std::string base_file = "data/siftsmall/siftsmall_base.fvecs";
+    std::string checkpoint = "data/siftsmall/siftsmall_groundtruth.ckpt";
+
+    // Interrupted run: stops after a few chunks, leaving a checkpoint behind
+    {
+        GroundTruthGenerator partial(base_file, query_data, query_size, query_dim, k, checkpoint, chunk_rows, 2);
+        partial.run(3);
+        std::cout << "Stopped at row " << partial.get_rows_done() << " of " << partial.get_base_rows() << std::endl;
+    }
+
+    // A new generator resumes from the checkpoint and streams the rest
+    GroundTruthGenerator generator(base_file, query_data, query_size, query_dim, k, checkpoint, chunk_rows, 2);
+    if (!generator.run()) {
+        std::cerr << "Ground truth generation failed" << std::endl;
+        return 1;
+    }
+    generator.write_ivecs("data/siftsmall/siftsmall_groundtruth_gen.ivecs");
+    generator.write_fvecs("data/siftsmall/siftsmall_groundtruth_gen.fvecs");
+    std::cout << "Generated ground truth in " << generator.get_runtime() << "ms" << std::endl;
+
+    // Check against the shipped ground truth, distance ties count as matches
+    GraphData<float> base(base_file);
+    GraphData<int> generated("data/siftsmall/siftsmall_groundtruth_gen.ivecs");
+    Recall agreement(groundtruth.get_data(), base.get_data(), query_data, generated.get_data(),
+                     query_dim, query_size, gt_dim, generated.get_vector_dim());
+    std::cout << "Agreement with shipped ground truth: " << agreement.get_recall() << std::endl;
+}
@@ -0,0 +1,40 @@
+#include <iostream>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/recall.hpp"
+#include "utils/imi.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int codebook_size = 64; // per half, 64 * 64 = 4096 cells
+
+    InvertedMultiIndex imi(base_dim, codebook_size);
+    if (!imi.build(base_data, base_size)) return 1;
+    std::cout << "IMI build time: " << imi.get_build_time() << "ms" << std::endl;
+    std::cout << "Cells: " << imi.get_num_cells() << " (" << imi.get_num_nonempty() << " non-empty, largest "
+              << imi.get_largest_cell() << " points)" << std::endl;
+
+    ANNS ann(base_dim, k, query_data, base_data, query_size, base_size);
+    for (int max_candidates : {250, 500, 1000, 2000, 4000}) {
+        ann.IMI_knn(imi, max_candidates);
+        Recall recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+        std::cout << "Candidates " << max_candidates << ": " << ann.get_runtime() << "ms, recall "
+                  << recall.get_recall() << std::endl;
+    }
+}
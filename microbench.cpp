@@ -0,0 +1,284 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include "utils/distance.hpp"
+#include "utils/pqueue.hpp"
+#include "utils/kmeans.hpp"
+
+#include <omp.h>
+#include <immintrin.h>
+#include <sched.h>
+#include <unistd.h>
+
+// Usage: microbench [repetitions] [first_cpu]
+// first_cpu >= 0 pins the main thread to it and OpenMP thread t to first_cpu + t.
+
+static volatile float sink;
+
+struct bench_stats_t {
+    double min_s;
+    double median_s;
+};
+
+// One warm-up run, then reps timed runs of fn
+template <typename Fn>
+bench_stats_t time_reps(int reps, Fn fn) {
+    fn();
+    std::vector<double> times(reps);
+    for (int r = 0; r < reps; ++r) {
+        double start = omp_get_wtime();
+        fn();
+        times[r] = omp_get_wtime() - start;
+    }
+    std::sort(times.begin(), times.end());
+    return bench_stats_t{times[0], times[reps / 2]};
+}
+
+void pin_team(int first_cpu) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    #pragma omp parallel
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((first_cpu + omp_get_thread_num()) % num_cpus, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+}
+
+// Peak FMA throughput: 8 independent accumulator chains hide the FMA latency
+double peak_gflops(int threads) {
+    const long iters = 20000000;
+    double start = omp_get_wtime();
+    #pragma omp parallel num_threads(threads)
+    {
+        __m256 acc[8];
+        for (int a = 0; a < 8; ++a) acc[a] = _mm256_set1_ps(static_cast<float>(a));
+        const __m256 x = _mm256_set1_ps(0.999999f), y = _mm256_set1_ps(1e-7f);
+        for (long i = 0; i < iters; ++i) {
+            for (int a = 0; a < 8; ++a) acc[a] = _mm256_fmadd_ps(acc[a], x, y);
+        }
+        __m256 total = acc[0];
+        for (int a = 1; a < 8; ++a) total = _mm256_add_ps(total, acc[a]);
+        sink = _mm256_reduce_add_ps(total);
+    }
+    double seconds = omp_get_wtime() - start;
+    return 2.0 * 8 * 8 * iters * threads / seconds / 1e9;
+}
+
+// Peak streaming read bandwidth over a buffer much larger than the LLC
+double peak_gbs(int threads) {
+    const size_t floats = static_cast<size_t>(64) << 20;   // 256 MB
+    float* buffer = static_cast<float*>(aligned_alloc(32, floats * sizeof(float)));
+    if (!buffer) throw std::bad_alloc();
+    #pragma omp parallel for num_threads(threads)
+    for (size_t i = 0; i < floats; ++i) buffer[i] = 1.0f;
+
+    bench_stats_t stats = time_reps(3, [&]() {
+        float total = 0;
+        #pragma omp parallel for num_threads(threads) reduction(+:total)
+        for (size_t i = 0; i < floats; i += 32) {
+            __m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_load_ps(buffer + i), _mm256_load_ps(buffer + i + 8)),
+                                     _mm256_add_ps(_mm256_load_ps(buffer + i + 16), _mm256_load_ps(buffer + i + 24)));
+            total += _mm256_reduce_add_ps(s);
+        }
+        sink = total;
+    });
+    free(buffer);
+    return floats * sizeof(float) / stats.min_s / 1e9;
+}
+
+void report(const std::string& name, double ops, double bytes, double flops, const bench_stats_t& stats,
+            double gflops_peak, double gbs_peak) {
+    double gbs = bytes / stats.min_s / 1e9;
+    double gflops = flops / stats.min_s / 1e9;
+    std::cout << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << stats.min_s * 1e9 / ops << std::setw(10) << stats.median_s * 1e9 / ops
+              << std::setw(9) << gbs << std::setw(7) << 100 * gbs / gbs_peak << "%"
+              << std::setw(9) << gflops << std::setw(7) << 100 * gflops / gflops_peak << "%" << std::endl;
+}
+
+void header(const std::string& title) {
+    std::cout << "\n" << title << "\n" << std::left << std::setw(44) << "benchmark" << std::right
+              << std::setw(10) << "ns/op" << std::setw(10) << "median" << std::setw(9) << "GB/s" << std::setw(8) << "%dram"
+              << std::setw(9) << "GFLOP/s" << std::setw(8) << "%fma" << std::endl;
+}
+
+void bench_distances(int reps, double gflops_peak, double gbs_peak) {
+    header("Distance kernels (1 thread, one query against a block of vectors)");
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> value(0.0f, 128.0f);
+
+    // cache resident block, then a block well past the LLC
+    for (size_t block_bytes : {static_cast<size_t>(128) << 10, static_cast<size_t>(256) << 20}) {
+        std::string where = block_bytes < (static_cast<size_t>(1) << 20) ? "L2" : "DRAM";
+        for (int dim : {16, 32, 64, 128, 256, 512, 960}) {
+            size_t n = block_bytes / (dim * sizeof(float));
+            // one spare float so every row can be shifted off its 32-byte alignment
+            float* data = static_cast<float*>(aligned_alloc(32, (n * dim + 8) * sizeof(float)));
+            float* query = static_cast<float*>(aligned_alloc(32, dim * sizeof(float)));
+            if (!data || !query) throw std::bad_alloc();
+            for (size_t i = 0; i < n * dim + 8; ++i) data[i] = value(gen);
+            for (int j = 0; j < dim; ++j) query[j] = value(gen);
+
+            double bytes = static_cast<double>(n) * dim * sizeof(float);
+            double flops = 3.0 * n * dim;   // sub, mul, add per element
+            std::string suffix = " d=" + std::to_string(dim) + " " + where;
+
+            // compute_distance_squared uses aligned AVX loads and faults on a
+            // misaligned row, so it is only measured aligned; the misaligned
+            // cost is shown by fast_euclidean below
+            report("compute_distance_squared aligned" + suffix, n, bytes, flops, time_reps(reps, [&]() {
+                float total = 0;
+                for (size_t i = 0; i < n; ++i) total += compute_distance_squared(dim, query, data + i * dim);
+                sink = total;
+            }), gflops_peak, gbs_peak);
+
+            report("fast_euclidean aligned" + suffix, n, bytes, flops, time_reps(reps, [&]() {
+                int total = 0;
+                for (size_t i = 0; i < n; ++i) total += fast_euclidean(query, data + i * dim, dim);
+                sink = static_cast<float>(total);
+            }), gflops_peak, gbs_peak);
+
+            report("fast_euclidean unaligned" + suffix, n, bytes, flops, time_reps(reps, [&]() {
+                int total = 0;
+                for (size_t i = 0; i < n; ++i) total += fast_euclidean(query, data + 1 + i * dim, dim);
+                sink = static_cast<float>(total);
+            }), gflops_peak, gbs_peak);
+
+            free(data);
+            free(query);
+        }
+    }
+}
+
+void bench_gather(int reps, double gflops_peak, double gbs_peak) {
+    header("Random gathers (1 thread, 1M ids into a 512 MB base, as in an IVF list scan)");
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> value(0.0f, 128.0f);
+    const int n = 1 << 20;
+
+    for (int dim : {64, 128, 256}) {
+        size_t rows = (static_cast<size_t>(512) << 20) / (dim * sizeof(float));
+        float* data = static_cast<float*>(aligned_alloc(32, rows * dim * sizeof(float)));
+        float* query = static_cast<float*>(aligned_alloc(32, dim * sizeof(float)));
+        if (!data || !query) throw std::bad_alloc();
+        for (size_t i = 0; i < rows * dim; ++i) data[i] = value(gen);
+        for (int j = 0; j < dim; ++j) query[j] = value(gen);
+        std::vector<int> ids(n);
+        std::uniform_int_distribution<int> row(0, static_cast<int>(rows) - 1);
+        for (int& id : ids) id = row(gen);
+        std::vector<float> dists(n);
+
+        double bytes = static_cast<double>(n) * dim * sizeof(float);
+        double flops = 3.0 * n * dim;
+        std::string suffix = " d=" + std::to_string(dim);
+
+        report("compute_distance_squared one by one" + suffix, n, bytes, flops, time_reps(reps, [&]() {
+            for (int i = 0; i < n; ++i) dists[i] = compute_distance_squared(dim, query, data + static_cast<size_t>(ids[i]) * dim);
+            sink = dists[n - 1];
+        }), gflops_peak, gbs_peak);
+
+        for (int ahead : {0, 4, 8, 16}) {
+            report("compute_distances_batch ahead=" + std::to_string(ahead) + suffix, n, bytes, flops, time_reps(reps, [&]() {
+                const int block = 64;
+                for (int b = 0; b < n; b += block) {
+                    compute_distances_batch(dim, query, data, ids.data() + b, std::min(block, n - b), dists.data() + b, ahead);
+                }
+                sink = dists[n - 1];
+            }), gflops_peak, gbs_peak);
+        }
+
+        free(data);
+        free(query);
+    }
+}
+
+void bench_pqueue(int reps) {
+    std::cout << "\nTop-k queue (1 thread, 1M random candidates)\n" << std::left << std::setw(44) << "benchmark"
+              << std::right << std::setw(10) << "ns/op" << std::setw(10) << "median" << std::endl;
+    const int n = 1 << 20;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> value(0.0f, 1e6f);
+    std::vector<std::pair<float, int>> candidates(n);
+    for (int i = 0; i < n; ++i) candidates[i] = std::make_pair(value(gen), i);
+
+    for (int k : {10, 100, 1000}) {
+        pqueue_t<int> queue(k);
+        bench_stats_t push = time_reps(reps, [&]() {
+            queue.reset(k);
+            for (int i = 0; i < n; ++i) queue.push(candidates[i].second, candidates[i].first);
+            sink = queue.get_tail_dist();
+        });
+
+        // batch_push merges a sorted batch, which may not exceed the capacity
+        int batch = std::min(64, k);
+        std::vector<std::pair<float, int>> ins;
+        ins.reserve(batch);
+        bench_stats_t batched = time_reps(reps, [&]() {
+            queue.reset(k);
+            for (int i = 0; i < n; i += batch) {
+                ins.assign(candidates.begin() + i, candidates.begin() + std::min(n, i + batch));
+                std::sort(ins.begin(), ins.end());
+                queue.batch_push(ins);
+            }
+            sink = queue.get_tail_dist();
+        });
+
+        std::cout << std::left << std::setw(44) << ("push k=" + std::to_string(k)) << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(10) << push.min_s * 1e9 / n << std::setw(10) << push.median_s * 1e9 / n << std::endl;
+        std::cout << std::left << std::setw(44) << ("batch_push k=" + std::to_string(k) + " batch=" + std::to_string(batch))
+                  << std::right << std::setw(10) << batched.min_s * 1e9 / n << std::setw(10) << batched.median_s * 1e9 / n << std::endl;
+    }
+}
+
+void bench_kmeans(int reps, double gflops_peak, double gbs_peak) {
+    int threads = omp_get_max_threads();
+    header("KMeans steps (" + std::to_string(threads) + " threads for assign, 1 for update; ns per point)");
+    const int n = 20000, dim = 128;
+    float* data = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(n) * dim * sizeof(float)));
+    if (!data) throw std::bad_alloc();
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> value(0.0f, 128.0f);
+    for (size_t i = 0; i < static_cast<size_t>(n) * dim; ++i) data[i] = value(gen);
+
+    for (int nlist : {16, 64, 256, 1024}) {
+        KMeans kmeans(nlist, dim, data, n);
+        kmeans.initialize_from_data();
+        std::string suffix = " nlist=" + std::to_string(nlist);
+
+        double assign_bytes = static_cast<double>(n) * dim * sizeof(float);
+        double assign_flops = 3.0 * n * nlist * dim;
+        report("assign_clusters" + suffix, n, assign_bytes, assign_flops,
+               time_reps(reps, [&]() { kmeans.assign_clusters(); }), gflops_peak * threads, gbs_peak);
+
+        double update_bytes = static_cast<double>(n) * dim * sizeof(float);
+        double update_flops = static_cast<double>(n) * dim;
+        report("update_clusters" + suffix, n, update_bytes, update_flops,
+               time_reps(reps, [&]() { kmeans.update_clusters(); }), gflops_peak, gbs_peak);
+    }
+    free(data);
+}
+
+int main(int argc, char** argv){
+    int reps = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+    int first_cpu = argc > 2 ? std::atoi(argv[2]) : -1;
+
+    // the main thread is OpenMP thread 0, so it lands on first_cpu
+    if (first_cpu >= 0) pin_team(first_cpu);
+
+    double gflops_peak = peak_gflops(1);
+    double gbs_peak = peak_gbs(omp_get_max_threads());
+    std::cout << "Repetitions: " << reps << (first_cpu >= 0 ? ", pinned from cpu " + std::to_string(first_cpu) : ", not pinned") << std::endl;
+    // cache resident kernels can go past 100% of the DRAM read peak
+    std::cout << "Measured peak: " << gflops_peak << " GFLOP/s per core (FMA), " << gbs_peak << " GB/s DRAM read" << std::endl;
+
+    bench_distances(reps, gflops_peak, gbs_peak);
+    bench_gather(reps, gflops_peak, gbs_peak);
+    bench_pqueue(reps);
+    bench_kmeans(reps, gflops_peak, gbs_peak);
+}
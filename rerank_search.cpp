@@ -0,0 +1,61 @@
+#include <iostream>
+#include <vector>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+#include "utils/rerank.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int R = 400; // candidates re-ranked per query
+    int num_clusters = 20;
+    int knn_cluster = 2; // should be 10% - 25% of num_clusters
+
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    const float* clusters = kmeans.get_clusters();
+
+    // Stage 1: approximate top R
+    ANNS ann(base_dim, R, query_data, base_data, query_size, base_size);
+    ann.IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+    auto candidate_time = ann.get_runtime();
+
+    // Stage 2: exact top k from the base file on disk
+    Reranker reranker("data/siftsmall/siftsmall_base.fvecs");
+    if (!reranker.ok()) return 1;
+    std::vector<int> results(static_cast<size_t>(query_size) * k);
+    if (!reranker.rerank(query_data, base_dim, query_size, ann.get_dist_lists(), R, k, results.data())) return 1;
+    auto rerank_time = reranker.get_runtime();
+
+    Recall recall(gt_data, base_data, query_data, results.data(), base_dim, query_size, gt_dim, k);
+
+    int num_threads = 0;
+    #pragma omp parallel
+    {
+        #pragma omp single
+        num_threads = omp_get_num_threads();
+    }
+    std::cout << "OpenMP two-stage ANN search (" << num_threads << " threads, R = " << R << ")\n";
+
+    std::cout << "Candidate time: " << candidate_time << "ms" << std::endl;
+    std::cout << "Re-rank time: " << rerank_time << "ms" << std::endl;
+    std::cout << "Latency: " << (candidate_time + rerank_time) / query_size << " ms/query" << std::endl;
+    std::cout << "Recall: " << recall.get_recall() << std::endl;
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+
+#include <omp.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int num_clusters = 20;
+    int knn_cluster = 4; // should be 10% - 25% of num_clusters
+
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    const float* clusters = kmeans.get_clusters();
+
+    size_t largest = 0;
+    for (const auto& list : ivf) largest = std::max(largest, list.size());
+    std::cout << "Largest list: " << largest << " of " << base_size << " points" << std::endl;
+
+    ANNS ann(base_dim, k, query_data, base_data, query_size, base_size);
+
+    double start = omp_get_wtime();
+    ann.IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+    double plain_ms = (omp_get_wtime() - start) * 1000;
+    Recall plain_recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+    std::cout << "IVF_knn makespan: " << plain_ms << "ms, recall " << plain_recall.get_recall() << std::endl;
+
+    start = omp_get_wtime();
+    ann.IVF_knn_scheduled(clusters, ivf, num_clusters, knn_cluster);
+    double scheduled_ms = (omp_get_wtime() - start) * 1000;
+    Recall scheduled_recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+    std::cout << "IVF_knn_scheduled makespan: " << scheduled_ms << "ms, recall " << scheduled_recall.get_recall() << std::endl;
+
+    std::vector<double> finish(query_size);
+    for (int i = 0; i < query_size; ++i) finish[i] = ann.get_finish_ms(i);
+    std::sort(finish.begin(), finish.end());
+    std::cout << "Query completion p50: " << finish[query_size / 2] << "ms, p99: "
+              << finish[std::min(query_size - 1, query_size * 99 / 100)] << "ms" << std::endl;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+#include "utils/shard.hpp"
+
+#include <omp.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int num_shards = 4;
+    int num_clusters = 20;
+    int knn_cluster = 4; // should be 10% - 25% of num_clusters
+    int timeout_ms = 2000;
+
+    // Each shard is its own process serving a contiguous slice with its own IVF
+    std::vector<std::string> paths;
+    std::vector<pid_t> servers;
+    for (int s = 0; s < num_shards; ++s) {
+        paths.push_back("/tmp/anns_shard_" + std::to_string(getpid()) + "_" + std::to_string(s) + ".sock");
+        int begin = static_cast<int>(static_cast<long>(base_size) * s / num_shards);
+        int end = static_cast<int>(static_cast<long>(base_size) * (s + 1) / num_shards);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            float* slice = base_data + static_cast<size_t>(begin) * base_dim;
+            KMeans kmeans(num_clusters, base_dim, slice, end - begin);
+            std::vector<std::vector<int>> ivf = kmeans.build_index();
+
+            ShardServer server(base_dim, slice, end - begin, begin);
+            server.set_ivf(kmeans.get_clusters(), &ivf, num_clusters, knn_cluster);
+            server.serve(paths[s]);
+            _exit(0);
+        }
+        servers.push_back(pid);
+    }
+
+    ShardCoordinator coordinator(paths, base_dim, k, timeout_ms);
+    std::vector<int> results(static_cast<size_t>(query_size) * k);
+
+    // Shards train their IVF before listening, retry until all are up
+    bool complete = false;
+    for (int attempt = 0; attempt < 100 && !complete; ++attempt) {
+        complete = coordinator.search(query_data, query_size, results.data());
+        if (!complete) usleep(100 * 1000);
+    }
+    complete = coordinator.search(query_data, query_size, results.data());
+    auto search_time = coordinator.get_runtime();
+
+    Recall recall(gt_data, base_data, query_data, results.data(), base_dim, query_size, gt_dim, k);
+
+    coordinator.shutdown_shards();
+    for (pid_t pid : servers) waitpid(pid, nullptr, 0);
+
+    std::cout << "Sharded ANN search (" << num_shards << " shard processes)\n";
+    std::cout << "Shards answered: " << coordinator.get_num_answered() << "/" << num_shards
+              << (complete ? "" : " (partial)") << std::endl;
+    std::cout << "Search time: " << search_time << "ms" << std::endl;
+    std::cout << "Throughput: " << query_size * 1000 / std::max(search_time, 1.0) << " query/s" << std::endl;
+    std::cout << "Recall: " << recall.get_recall() << std::endl;
+}
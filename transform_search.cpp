@@ -0,0 +1,97 @@
+#include <iostream>
+#include <vector>
+#include "utils/distance.hpp"
+#include "utils/anns.hpp"
+#include "utils/data.hpp"
+#include "utils/kmeans.hpp"
+#include "utils/recall.hpp"
+#include "utils/pq.hpp"
+#include "utils/rerank.hpp"
+#include "utils/transform.hpp"
+
+#include <omp.h>
+
+// Mean squared PQ reconstruction error of data (already in the PQ space)
+double pq_error(const float* data, int num_points, int dim, int num_subspaces) {
+    ProductQuantizer pq(dim, num_subspaces);
+    pq.train(data, num_points, num_points);
+    std::vector<uint8_t> codes(static_cast<size_t>(num_points) * num_subspaces);
+    std::vector<float> decoded(static_cast<size_t>(num_points) * dim);
+    pq.encode(data, num_points, codes.data());
+    pq.decode(codes.data(), num_points, decoded.data());
+    double error = 0;
+    for (size_t j = 0; j < static_cast<size_t>(num_points) * dim; ++j) {
+        double diff = data[j] - decoded[j];
+        error += diff * diff;
+    }
+    return error / num_points;
+}
+
+int main(){
+    GraphData<float> base("data/siftsmall/siftsmall_base.fvecs");
+    GraphData<float> query("data/siftsmall/siftsmall_query.fvecs");
+    GraphData<int> groundtruth("data/siftsmall/siftsmall_groundtruth.ivecs");
+
+    int base_dim = base.get_vector_dim();
+    int gt_dim = groundtruth.get_vector_dim();
+    int query_size = query.get_num_vectors();
+    int base_size = base.get_num_vectors();
+
+    float* base_data = base.get_data();
+    float* query_data = query.get_data();
+    int* gt_data = groundtruth.get_data();
+
+    int k = 100;
+    int num_clusters = 20;
+    int knn_cluster = 4; // should be 10% - 25% of num_clusters
+    int reduced_dim = base_dim / 2;
+
+    // PCA, trained on the base and applied to base and queries before KMeans and ANNS
+    PCATransform pca(base_dim, reduced_dim);
+    double start = omp_get_wtime();
+    if (!pca.train(base_data, base_size)) return 1;
+    TransformedSet pca_base(pca, base_data, base_size);
+    double build_ms = (omp_get_wtime() - start) * 1000;
+    start = omp_get_wtime();
+    TransformedSet pca_query(pca, query_data, query_size);
+    double query_ms = (omp_get_wtime() - start) * 1000;
+    std::cout << "PCA " << base_dim << " -> " << reduced_dim << ", explained variance "
+              << pca.get_explained_variance() << std::endl;
+    std::cout << "Train + transform base: " << build_ms << "ms, transform queries: " << query_ms << "ms" << std::endl;
+
+    KMeans kmeans(num_clusters, base_dim, base_data, base_size);
+    std::vector<std::vector<int>> ivf = kmeans.build_index();
+    ANNS ann(base_dim, k, query_data, base_data, query_size, base_size);
+    ann.IVF_knn(kmeans.get_clusters(), ivf, num_clusters, knn_cluster);
+    Recall recall(gt_data, base_data, query_data, ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+    std::cout << "IVF full dim: " << ann.get_runtime() << "ms, recall " << recall.get_recall() << std::endl;
+
+    KMeans pca_kmeans(num_clusters, reduced_dim, pca_base.get_data(), base_size);
+    std::vector<std::vector<int>> pca_ivf = pca_kmeans.build_index();
+    ANNS pca_ann(reduced_dim, k, pca_query.get_data(), pca_base.get_data(), query_size, base_size);
+    pca_ann.IVF_knn(pca_kmeans.get_clusters(), pca_ivf, num_clusters, knn_cluster);
+    Recall pca_recall(gt_data, base_data, query_data, pca_ann.get_dist_lists(), base_dim, query_size, gt_dim, k);
+    std::cout << "IVF PCA dim: " << pca_ann.get_runtime() << "ms, recall " << pca_recall.get_recall() << std::endl;
+
+    // The reduced space reorders close neighbours, re-rank a wider shortlist on the full vectors
+    int R = 4 * k;
+    ANNS wide_ann(reduced_dim, R, pca_query.get_data(), pca_base.get_data(), query_size, base_size);
+    wide_ann.IVF_knn(pca_kmeans.get_clusters(), pca_ivf, num_clusters, knn_cluster);
+    Reranker reranker("data/siftsmall/siftsmall_base.fvecs");
+    if (!reranker.ok()) return 1;
+    std::vector<int> results(static_cast<size_t>(query_size) * k);
+    if (!reranker.rerank(query_data, base_dim, query_size, wide_ann.get_dist_lists(), R, k, results.data())) return 1;
+    Recall rerank_recall(gt_data, base_data, query_data, results.data(), base_dim, query_size, gt_dim, k);
+    std::cout << "IVF PCA dim + rerank " << R << ": " << wide_ann.get_runtime() + reranker.get_runtime()
+              << "ms, recall " << rerank_recall.get_recall() << std::endl;
+
+    // OPQ, the rotation should lower the PQ reconstruction error
+    int num_subspaces = 16;
+    OPQTransform opq(base_dim);
+    start = omp_get_wtime();
+    if (!opq.train(base_data, base_size, num_subspaces)) return 1;
+    std::cout << "OPQ train: " << (omp_get_wtime() - start) * 1000 << "ms" << std::endl;
+    TransformedSet opq_base(opq, base_data, base_size);
+    std::cout << "PQ reconstruction error: " << pq_error(base_data, base_size, base_dim, num_subspaces) << std::endl;
+    std::cout << "OPQ + PQ reconstruction error: " << pq_error(opq_base.get_data(), base_size, base_dim, num_subspaces) << std::endl;
+}
@@ -7,12 +7,27 @@
 #include <chrono>
 #include <queue>
 #include <utility>
+#include <climits>
+#include <atomic>
+#include <memory>
 #include "distance.hpp"
 #include "pqueue.hpp"
+#include "numa.hpp"
+#include "binary.hpp"
+#include "search_context.hpp"
+#include "query_cache.hpp"
+#include "scheduler.hpp"
+#include "imi.hpp"
 
 #include <omp.h>
 #include <immintrin.h> 
 
+// Per query limits for the anytime search. A zero field means no limit.
+struct search_budget_t {
+    double deadline_us = 0.0;     // wall time from the start of the query
+    long max_distances = 0;       // distance computations, centroids included
+};
+
 class ANNS{
     private:
         int vector_dim;
@@ -26,7 +41,120 @@ class ANNS{
 
         int* dist_lists;
         double runtime;
+        std::vector<uint8_t> complete_flags;
+        std::vector<double> finish_ms;
+
+        // Batch scratch of the scheduled and NUMA searches, reused by later batches
+        std::vector<int> probes;
+        std::vector<list_task_t> tasks;
+        std::vector<int> task_begin;
+        std::vector<long> task_costs;
+        std::vector<int> task_ids;
+        std::vector<float> task_dists;
+        std::vector<std::atomic<int>> remaining;
+        std::unique_ptr<WorkStealingPool> pool;
+        std::vector<int> shard_ids;
+        std::vector<float> shard_dists;
+        std::vector<std::vector<std::vector<int>>> local_ivf;
+
+        // Per-shard top-k laid out as [shard][query][k], unused slots hold -1
+        void merge_shards(int num_shards) {
+            #pragma omp parallel for
+            for (int i = 0; i < query_size; ++i) {
+                SearchContext& ctx = thread_search_context();
+                ctx.run_ids.resize(num_shards);
+                ctx.run_dists.resize(num_shards);
+                for (int n = 0; n < num_shards; ++n) {
+                    size_t offset = (static_cast<size_t>(n) * query_size + i) * k;
+                    ctx.run_ids[n] = &shard_ids[offset];
+                    ctx.run_dists[n] = &shard_dists[offset];
+                }
+
+                int* dist_ptr = dist_lists + (i * k);
+                float* merged = ctx.floats(k);
+                int found = kway_merge(ctx.run_ids, ctx.run_dists, k, k, dist_ptr, merged);
+                std::fill(dist_ptr + found, dist_ptr + k, -1);
+            }
+        }
     
+        // Exact re-scoring of first stage candidates into the final top-k
+        void rescore(const float* query_ptr, pqueue_t<int>& candidates, int* dist_ptr) {
+            pqueue_t<int>& S = thread_search_context().results;
+            S.reset(k);
+            for (int c = 0; c < candidates.size(); ++c) {
+                const float* point = data_vecs + static_cast<size_t>(candidates[c]) * vector_dim;
+                float dist = compute_distance_squared(vector_dim, query_ptr, point);
+                S.push(candidates[c], dist);
+            }
+            for (int m = 0; m < k; ++m) {
+                dist_ptr[m] = m < S.size() ? S[m] : -1;
+            }
+        }
+
+        // Scores ids in blocks with the batched kernel and merges each block into S
+        void scan_list(const float* query_ptr, const int* ids, int n, pqueue_t<int>& S) {
+            const int block = 64;
+            SearchContext& ctx = thread_search_context();
+            float* dists = ctx.floats(block);
+            for (int b = 0; b < n; b += block) {
+                int count = std::min(block, n - b);
+                compute_distances_batch(vector_dim, query_ptr, data_vecs, ids + b, count, dists);
+                S.batch_push(ids + b, dists, count, ctx.scored);
+            }
+        }
+
+        void brute_query(const float* query_ptr, int* dist_ptr) {
+            pqueue_t<int>& S = thread_search_context().results;
+            S.reset(k);
+
+            for (int j = 0; j < data_size; ++j) {
+                const float* data_ptr = data_vecs + (j * vector_dim);
+                int dist = compute_distance_squared(vector_dim, query_ptr, data_ptr);
+                S.push(j, dist);
+            }
+
+            for (int s = 0; s < k; ++s) {
+                dist_ptr[s] = s < S.size() ? S[s] : -1;
+            }
+        }
+
+        void IVF_query(const float* query_ptr, const float* clusters, const std::vector<std::vector<int>>& ivf,
+                       int num_clusters, int knn_cluster, int* dist_ptr) {
+            pqueue_t<int>& C = thread_search_context().clusters;
+            C.reset(knn_cluster);
+
+            // Get k closest clusters
+            for (int j = 0; j < num_clusters; ++j) {
+                const float* cluster = clusters + j*vector_dim;
+                int dist = compute_distance_squared(vector_dim, query_ptr, cluster);
+                C.push(j, dist);
+            }
+
+            pqueue_t<int>& S = thread_search_context().results;
+            S.reset(k);
+            // Get closests points from closest clusters
+            for(int s = 0; s < knn_cluster; s++){
+                int cluster_id = C[s];
+                const std::vector<int>& data_list = ivf[cluster_id];
+                scan_list(query_ptr, data_list.data(), static_cast<int>(data_list.size()), S);
+            }
+
+            for (int m = 0; m < k; ++m) {
+                dist_ptr[m] = m < S.size() ? S[m] : -1;
+            }
+        }
+
+        // Answers from the cache when possible, otherwise runs search() and
+        // caches its result together with how long it took
+        template <typename Search>
+        void cached_query(QueryCache& cache, uint64_t config, const float* query_ptr, int* dist_ptr, Search search) {
+            if (cache.lookup(query_ptr, config, dist_ptr)) return;
+            auto start = std::chrono::steady_clock::now();
+            search();
+            auto stop = std::chrono::steady_clock::now();
+            cache.insert(query_ptr, config, dist_ptr, std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+        }
+
     public:
         ANNS(const int& dim, const int& k_val, const float* query, const float* data, int qsize, int dsize) :
         vector_dim(dim), k(k_val), query_vecs(query), data_vecs(data), query_size(qsize), data_size(dsize) {
@@ -42,59 +170,462 @@ class ANNS{
             auto start = std::chrono::high_resolution_clock::now();
             #pragma omp parallel for //schedule(dynamic, 1)
             for (int i = 0; i < query_size; ++i) {
-                const float* query_ptr = query_vecs + (i * vector_dim); 
-                pqueue_t<int> S(k);
-                
-                for (int j = 0; j < data_size; ++j) {
-                    const float* data_ptr = data_vecs + (j * vector_dim);
-                    int dist = compute_distance_squared(vector_dim, query_ptr, data_ptr);
-                    S.push(j, dist);
-                }
-
-                int* dist_ptr = dist_lists + (i * k);
-                for (int s = 0; s < k; ++s) {
-                    dist_ptr[s] = S[s];
-                }
+                brute_query(query_vecs + (i * vector_dim), dist_lists + (i * k));
             }
             auto stop = std::chrono::high_resolution_clock::now();
             runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
         }
 
-        void IVF_knn(const float* clusters, std::vector<std::vector<int>> ivf, int num_clusters, int knn_cluster) {     
+        void IVF_knn(const float* clusters, const std::vector<std::vector<int>>& ivf, int num_clusters, int knn_cluster) {     
             auto start = std::chrono::high_resolution_clock::now();  
 
             #pragma omp parallel for schedule(dynamic, 1)
             for (int i = 0; i < query_size; ++i) {
-                const float* query_ptr = query_vecs + (i * vector_dim); 
-                pqueue_t<int> C(knn_cluster);
+                IVF_query(query_vecs + (i * vector_dim), clusters, ivf, num_clusters, knn_cluster, dist_lists + (i * k));
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count(); 
+
+        }
+
+        // Anytime IVF_knn: probes lists best-first and stops as soon as the
+        // query's budget runs out, keeping the best top-k found so far. The
+        // centroid scan may use at most half of each budget, so a truncated
+        // query always has the rest for the lists nearest the centroids it saw.
+        // is_complete(i) tells whether query i scanned all knn_cluster lists.
+        void IVF_knn_bounded(const float* clusters, const std::vector<std::vector<int>>& ivf, int num_clusters, int knn_cluster,
+                             const search_budget_t& budget) {
+            auto start = std::chrono::high_resolution_clock::now();
+            complete_flags.assign(query_size, 1);
+            // the clock is read once per this many distances
+            const int check_every = 64;
+            long max_distances = budget.max_distances > 0 ? budget.max_distances : LONG_MAX;
+            long centroid_distances = budget.max_distances > 0 ? std::max(1L, max_distances / 2) : LONG_MAX;
+            auto time_budget = std::chrono::nanoseconds(static_cast<long>(budget.deadline_us * 1000));
 
-                // Get k closest clusters
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (int i = 0; i < query_size; ++i) {
+                auto query_start = std::chrono::steady_clock::now();
+                auto centroid_deadline = query_start + time_budget / 2;
+                auto deadline = query_start + time_budget;
+                long computed = 0;
+                auto out_of_budget = [&](long limit, std::chrono::steady_clock::time_point until) {
+                    return computed >= limit ||
+                           (budget.deadline_us > 0 && computed % check_every == 0 &&
+                            std::chrono::steady_clock::now() >= until);
+                };
+
+                const float* query_ptr = query_vecs + (i * vector_dim);
+                pqueue_t<int>& C = thread_search_context().clusters;
+                C.reset(knn_cluster);
+                bool truncated = false;
                 for (int j = 0; j < num_clusters; ++j) {
+                    // an empty list can't give candidates, so it isn't worth budget
+                    if (ivf[j].empty()) continue;
+                    if (out_of_budget(centroid_distances, centroid_deadline)) {
+                        truncated = true;
+                        break;
+                    }
                     const float* cluster = clusters + j*vector_dim;
                     int dist = compute_distance_squared(vector_dim, query_ptr, cluster);
                     C.push(j, dist);
+                    computed++;
                 }
 
-                pqueue_t<int> S(k);
-                // Get closests points from closest clusters    
-                for(int s = 0; s < knn_cluster; s++){
-                    int cluster_id = C[s];
-                    const std::vector<int>& data_list = ivf[cluster_id];
-                    for(int id:data_list){
-                        const float* point = data_vecs + id*vector_dim;
+                pqueue_t<int>& S = thread_search_context().results;
+                S.reset(k);
+                bool exhausted = false;
+                // C is sorted, so lists are visited nearest centroid first
+                for (int s = 0; s < C.size() && !exhausted; s++) {
+                    const std::vector<int>& data_list = ivf[C[s]];
+                    for (size_t p = 0; p < data_list.size(); ++p) {
+                        if (out_of_budget(max_distances, deadline)) {
+                            exhausted = true;
+                            break;
+                        }
+                        const float* point = data_vecs + data_list[p]*vector_dim;
                         int dist = compute_distance_squared(vector_dim, query_ptr, point);
-                        S.push(id, dist);
+                        S.push(data_list[p], dist);
+                        computed++;
                     }
                 }
 
+                complete_flags[i] = truncated || exhausted ? 0 : 1;
                 int* dist_ptr = dist_lists + (i * k);
                 for (int m = 0; m < k; ++m) {
-                    dist_ptr[m] = S[m];
+                    dist_ptr[m] = m < S.size() ? S[m] : -1;
                 }
             }
             auto stop = std::chrono::high_resolution_clock::now();
-            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count(); 
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // IVF_knn with a query's probed lists cut into (query, list chunk)
+        // tasks of at most grain points (0 picks one from the total work) and
+        // run on a work-stealing pool, so one huge list no longer pins a
+        // single thread. The last task of a query merges its partial top-k.
+        void IVF_knn_scheduled(const float* clusters, const std::vector<std::vector<int>>& ivf, int num_clusters,
+                               int knn_cluster, int grain = 0) {
+            auto start = std::chrono::high_resolution_clock::now();
+            knn_cluster = std::min(knn_cluster, num_clusters);
+            finish_ms.assign(query_size, 0.0);
+
+            probes.assign(static_cast<size_t>(query_size) * knn_cluster, -1);
+            #pragma omp parallel for
+            for (int i = 0; i < query_size; ++i) {
+                const float* query_ptr = query_vecs + (i * vector_dim);
+                pqueue_t<int>& C = thread_search_context().clusters;
+                C.reset(knn_cluster);
+                for (int j = 0; j < num_clusters; ++j) {
+                    const float* cluster = clusters + j*vector_dim;
+                    int dist = compute_distance_squared(vector_dim, query_ptr, cluster);
+                    C.push(j, dist);
+                }
+                for (int s = 0; s < C.size(); ++s) probes[static_cast<size_t>(i) * knn_cluster + s] = C[s];
+            }
+
+            if (!pool || pool->get_num_workers() != omp_get_max_threads()) pool.reset(new WorkStealingPool());
+            if (grain <= 0) {
+                long total = 0;
+                for (int probe : probes) total += probe >= 0 ? static_cast<long>(ivf[probe].size()) : 0;
+                grain = static_cast<int>(std::max(256L, total / (16L * pool->get_num_workers())));
+            }
+            split_list_tasks(ivf, probes, query_size, knn_cluster, grain, tasks, task_begin);
+
+            task_costs.resize(tasks.size());
+            for (size_t t = 0; t < tasks.size(); ++t) task_costs[t] = static_cast<long>(tasks[t].end - tasks[t].begin) * vector_dim;
+            pool->assign(task_costs);
+
+            task_ids.resize(tasks.size() * k);
+            task_dists.resize(tasks.size() * k);
+            // atomics can't be moved, so the counters are replaced only when they grow
+            if (remaining.size() < static_cast<size_t>(query_size)) std::vector<std::atomic<int>>(query_size).swap(remaining);
+            for (int i = 0; i < query_size; ++i) {
+                remaining[i].store(task_begin[i + 1] - task_begin[i], std::memory_order_relaxed);
+                if (task_begin[i + 1] == task_begin[i]) std::fill(dist_lists + (i * k), dist_lists + (i * k) + k, -1);
+            }
+
+            pool->run([&](int t) {
+                const list_task_t& task = tasks[t];
+                const float* query_ptr = query_vecs + (task.query * vector_dim);
+                const std::vector<int>& data_list = ivf[task.list];
+                pqueue_t<int>& S = thread_search_context().results;
+                S.reset(k);
+                scan_list(query_ptr, data_list.data() + task.begin, task.end - task.begin, S);
+                int* ids = &task_ids[static_cast<size_t>(t) * k];
+                float* dists = &task_dists[static_cast<size_t>(t) * k];
+                for (int m = 0; m < k; ++m) {
+                    ids[m] = m < S.size() ? S[m] : -1;
+                    dists[m] = m < S.size() ? S.get_dist(m) : 0.0f;
+                }
+
+                if (remaining[task.query].fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+                int first = task_begin[task.query];
+                int num_runs = task_begin[task.query + 1] - first;
+                SearchContext& ctx = thread_search_context();
+                ctx.run_ids.resize(num_runs);
+                ctx.run_dists.resize(num_runs);
+                for (int r = 0; r < num_runs; ++r) {
+                    ctx.run_ids[r] = &task_ids[static_cast<size_t>(first + r) * k];
+                    ctx.run_dists[r] = &task_dists[static_cast<size_t>(first + r) * k];
+                }
+                int* dist_ptr = dist_lists + (task.query * k);
+                float* merged = ctx.floats(k);
+                int found = kway_merge(ctx.run_ids, ctx.run_dists, k, k, dist_ptr, merged);
+                std::fill(dist_ptr + found, dist_ptr + k, -1);
+                finish_ms[task.query] = std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            });
+
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // Exact top-k over the inverted multi-index cells visited, nearest
+        // first, until at least max_candidates points are collected
+        void IMI_knn(const InvertedMultiIndex& imi, int max_candidates) {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (int i = 0; i < query_size; ++i) {
+                const float* query_ptr = query_vecs + (i * vector_dim);
+                SearchContext& ctx = thread_search_context();
+                int* ids = ctx.ints(static_cast<size_t>(max_candidates) + imi.get_largest_cell());
+                int n = imi.candidates(query_ptr, max_candidates, ids);
+
+                pqueue_t<int>& S = ctx.results;
+                S.reset(k);
+                scan_list(query_ptr, ids, n, S);
+                int* dist_ptr = dist_lists + (i * k);
+                for (int m = 0; m < k; ++m) {
+                    dist_ptr[m] = m < S.size() ? S[m] : -1;
+                }
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // brute_knn behind a result cache, which must have been built for the same k.
+        // Entries are keyed by engine and IVF parameters, so one cache can serve both.
+        void brute_knn_cached(QueryCache& cache) {
+            if (cache.get_k() != k) {
+                std::cerr << "Cache holds top-" << cache.get_k() << ", search wants top-" << k << std::endl;
+                return brute_knn();
+            }
+            uint64_t config = QueryCache::config_key(CACHE_BRUTE, QueryCache::fingerprint(data_vecs, data_size, vector_dim));
+            auto start = std::chrono::high_resolution_clock::now();
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (int i = 0; i < query_size; ++i) {
+                const float* query_ptr = query_vecs + (i * vector_dim);
+                int* dist_ptr = dist_lists + (i * k);
+                cached_query(cache, config, query_ptr, dist_ptr, [&]() { brute_query(query_ptr, dist_ptr); });
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        void IVF_knn_cached(QueryCache& cache, const float* clusters, const std::vector<std::vector<int>>& ivf,
+                            int num_clusters, int knn_cluster) {
+            if (cache.get_k() != k) {
+                std::cerr << "Cache holds top-" << cache.get_k() << ", search wants top-" << k << std::endl;
+                return IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+            }
+            // the index is told apart by its centroids and list sizes, plus the base they point into
+            uint64_t index_key = QueryCache::mix(QueryCache::fingerprint(data_vecs, data_size, vector_dim),
+                                                 QueryCache::fingerprint(clusters, num_clusters, vector_dim, num_clusters));
+            for (const std::vector<int>& list : ivf) index_key = QueryCache::mix(index_key, list.size());
+            uint64_t config = QueryCache::config_key(CACHE_IVF, index_key, num_clusters, knn_cluster);
+            auto start = std::chrono::high_resolution_clock::now();
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (int i = 0; i < query_size; ++i) {
+                const float* query_ptr = query_vecs + (i * vector_dim);
+                int* dist_ptr = dist_lists + (i * k);
+                cached_query(cache, config, query_ptr, dist_ptr, [&]() {
+                    IVF_query(query_ptr, clusters, ivf, num_clusters, knn_cluster, dist_ptr);
+                });
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // NUMA variant of brute_knn for a base set loaded in NUMA_SHARD mode.
+        // Each node gets a team of pinned threads that only scans the rows
+        // resident on that node; per-shard top-k are merged at the end.
+        void brute_knn_numa(const NumaShards& shards) {
+            int num_shards = shards.get_num_shards();
+            if (num_shards <= 0) {
+                // not loaded in NUMA_SHARD mode, nothing to keep node local
+                return brute_knn();
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            int team = std::max(1, omp_get_max_threads() / num_shards);
+            int num_workers = num_shards * team;
+
+            size_t num_slots = static_cast<size_t>(num_shards) * query_size * k;
+            shard_ids.assign(num_slots, -1);
+            shard_dists.assign(num_slots, FLT_MAX);
+
+            #pragma omp parallel num_threads(num_workers)
+            {
+                // OpenMP may grant fewer threads than asked, so every thread
+                // takes each num_threads-th (node, rank) worker slot
+                for (int w = omp_get_thread_num(); w < num_workers; w += omp_get_num_threads()) {
+                    int node = w / team;
+                    int rank = w % team;
+                    const std::vector<int>& cpus = shards.topo.get_cpus(node);
+                    ThreadPin pin(cpus[rank % cpus.size()]);
+
+                    for (int i = rank; i < query_size; i += team) {
+                        const float* query_ptr = query_vecs + (i * vector_dim);
+                        pqueue_t<int>& S = thread_search_context().results;
+                        S.reset(k);
+
+                        for (int j = shards.row_begin[node]; j < shards.row_begin[node + 1]; ++j) {
+                            const float* data_ptr = data_vecs + (static_cast<size_t>(j) * vector_dim);
+                            float dist = compute_distance_squared(vector_dim, query_ptr, data_ptr);
+                            S.push(j, dist);
+                        }
+
+                        size_t offset = (static_cast<size_t>(node) * query_size + i) * k;
+                        for (int s = 0; s < S.size(); ++s) {
+                            shard_ids[offset + s] = S[s];
+                            shard_dists[offset + s] = S.get_dist(s);
+                        }
+                    }
+                }
+            }
+
+            merge_shards(num_shards);
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // NUMA variant of IVF_knn. Every inverted list is split by shard so a
+        // node's team scans only its local members of the probed lists. The
+        // split lists are built by a thread on each node so they are first
+        // touched (and placed) there too.
+        void IVF_knn_numa(const float* clusters, const std::vector<std::vector<int>>& ivf, int num_clusters, int knn_cluster,
+                          const NumaShards& shards) {
+            int num_shards = shards.get_num_shards();
+            if (num_shards <= 0) {
+                return IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            int team = std::max(1, omp_get_max_threads() / num_shards);
+            int num_workers = num_shards * team;
+
+            size_t num_slots = static_cast<size_t>(num_shards) * query_size * k;
+            shard_ids.assign(num_slots, -1);
+            shard_dists.assign(num_slots, FLT_MAX);
+            // split lists keep their capacity from the last batch
+            local_ivf.resize(num_shards);
+
+            #pragma omp parallel num_threads(num_workers)
+            {
+                // worker slots as in brute_knn_numa, rank 0 of a node splits its lists
+                for (int w = omp_get_thread_num(); w < num_workers; w += omp_get_num_threads()) {
+                    int node = w / team;
+                    if (w % team != 0) continue;
+                    const std::vector<int>& cpus = shards.topo.get_cpus(node);
+                    ThreadPin pin(cpus[0]);
+
+                    std::vector<std::vector<int>>& lists = local_ivf[node];
+                    lists.resize(num_clusters);
+                    for (int c = 0; c < num_clusters; ++c) {
+                        lists[c].clear();
+                        for (int id : ivf[c]) {
+                            if (id >= shards.row_begin[node] && id < shards.row_begin[node + 1]) lists[c].push_back(id);
+                        }
+                    }
+                }
+                #pragma omp barrier
+
+                for (int w = omp_get_thread_num(); w < num_workers; w += omp_get_num_threads()) {
+                    int node = w / team;
+                    int rank = w % team;
+                    const std::vector<int>& cpus = shards.topo.get_cpus(node);
+                    ThreadPin pin(cpus[rank % cpus.size()]);
+
+                    const std::vector<std::vector<int>>& lists = local_ivf[node];
+                    for (int i = rank; i < query_size; i += team) {
+                        const float* query_ptr = query_vecs + (i * vector_dim);
+                        pqueue_t<int>& C = thread_search_context().clusters;
+                        C.reset(knn_cluster);
+
+                        for (int j = 0; j < num_clusters; ++j) {
+                            const float* cluster = clusters + j*vector_dim;
+                            float dist = compute_distance_squared(vector_dim, query_ptr, cluster);
+                            C.push(j, dist);
+                        }
+
+                        pqueue_t<int>& S = thread_search_context().results;
+                        S.reset(k);
+                        for (int s = 0; s < C.size(); s++) {
+                            for (int id : lists[C[s]]) {
+                                const float* point = data_vecs + static_cast<size_t>(id)*vector_dim;
+                                float dist = compute_distance_squared(vector_dim, query_ptr, point);
+                                S.push(id, dist);
+                            }
+                        }
+
+                        size_t offset = (static_cast<size_t>(node) * query_size + i) * k;
+                        for (int m = 0; m < S.size(); ++m) {
+                            shard_ids[offset + m] = S[m];
+                            shard_dists[offset + m] = S.get_dist(m);
+                        }
+                    }
+                }
+            }
+
+            merge_shards(num_shards);
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // brute_knn with a Hamming prefilter: scans the 1-bit codes for the R
+        // closest candidates, then re-scores only those with exact distances
+        void brute_knn_binary(const BinaryQuantizer& quantizer, const BinaryCodes& codes, int R) {
+            auto start = std::chrono::high_resolution_clock::now();
+            int num_words = codes.get_num_words();
+
+            #pragma omp parallel
+            {
+                uint64_t* query_code = thread_search_context().words(num_words);
+
+                #pragma omp for
+                for (int i = 0; i < query_size; ++i) {
+                    const float* query_ptr = query_vecs + (i * vector_dim);
+                    quantizer.encode_one(query_ptr, query_code);
+
+                    pqueue_t<int>& C = thread_search_context().candidates;
+                    C.reset(R);
+                    for (int j = 0; j < data_size; ++j) {
+                        int dist = hamming_distance(query_code, codes.get_code(j), num_words);
+                        if (C.size() == R && dist >= C.get_tail_dist()) continue;
+                        C.push(j, dist);
+                    }
+
+                    rescore(query_ptr, C, dist_lists + (i * k));
+                }
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // IVF_knn with the same Hamming prefilter over the probed lists
+        void IVF_knn_binary(const float* clusters, const std::vector<std::vector<int>>& ivf, int num_clusters, int knn_cluster,
+                            const BinaryQuantizer& quantizer, const BinaryCodes& codes, int R) {
+            auto start = std::chrono::high_resolution_clock::now();
+            int num_words = codes.get_num_words();
+
+            #pragma omp parallel
+            {
+                uint64_t* query_code = thread_search_context().words(num_words);
+
+                #pragma omp for schedule(dynamic, 1)
+                for (int i = 0; i < query_size; ++i) {
+                    const float* query_ptr = query_vecs + (i * vector_dim);
+                    quantizer.encode_one(query_ptr, query_code);
+
+                    pqueue_t<int>& C = thread_search_context().clusters;
+                    C.reset(knn_cluster);
+                    for (int j = 0; j < num_clusters; ++j) {
+                        const float* cluster = clusters + j*vector_dim;
+                        int dist = compute_distance_squared(vector_dim, query_ptr, cluster);
+                        C.push(j, dist);
+                    }
+
+                    pqueue_t<int>& H = thread_search_context().candidates;
+                    H.reset(R);
+                    for (int s = 0; s < C.size(); s++) {
+                        for (int id : ivf[C[s]]) {
+                            int dist = hamming_distance(query_code, codes.get_code(id), num_words);
+                            if (H.size() == R && dist >= H.get_tail_dist()) continue;
+                            H.push(id, dist);
+                        }
+                    }
+
+                    rescore(query_ptr, H, dist_lists + (i * k));
+                }
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        }
+
+        // Only set by IVF_knn_bounded
+        bool is_complete(int i) const {
+            return complete_flags.empty() || complete_flags[i];
+        }
+
+        // Time from the start of the last IVF_knn_scheduled batch until query i was merged
+        double get_finish_ms(int i) const {
+            return i < static_cast<int>(finish_ms.size()) ? finish_ms[i] : 0.0;
+        }
 
+        int get_num_incomplete() const {
+            int count = 0;
+            for (uint8_t flag : complete_flags) count += flag ? 0 : 1;
+            return count;
         }
 
         int* get_dist_lists(){
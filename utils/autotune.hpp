@@ -0,0 +1,127 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "anns.hpp"
+#include "kmeans.hpp"
+#include "recall.hpp"
+
+#include <omp.h>
+
+struct tune_point_t {
+    int num_clusters;
+    int knn_cluster;
+    double recall;
+    double latency_us;     // mean per query, best of the repetitions
+};
+
+// Picks num_clusters / knn_cluster for IVF_knn on a held-out query sample.
+// Exact answers come from brute_knn once. Each num_clusters gets one KMeans
+// index, then knn_cluster is binary searched for the smallest value that
+// reaches the target (recall grows with the number of probed lists), so a
+// list count costs O(log num_clusters) measured searches. Every measurement
+// is kept in the curve.
+class IVFAutotuner {
+private:
+    int vector_dim;
+    int k;
+    float* base_data;
+    int base_size;
+    const float* query_data;
+    int query_size;
+    int repetitions;
+
+    std::vector<int> exact;
+    std::vector<tune_point_t> curve;
+    int best = -1;
+
+    tune_point_t measure(ANNS& ann, const float* clusters, const std::vector<std::vector<int>>& ivf,
+                         int num_clusters, int knn_cluster) {
+        double best_ms = std::numeric_limits<double>::max();
+        for (int r = 0; r < repetitions; ++r) {
+            double start = omp_get_wtime();
+            ann.IVF_knn(clusters, ivf, num_clusters, knn_cluster);
+            best_ms = std::min(best_ms, (omp_get_wtime() - start) * 1000);
+        }
+        Recall recall(exact.data(), base_data, query_data, ann.get_dist_lists(), vector_dim, query_size, k, k);
+        tune_point_t point{num_clusters, knn_cluster, recall.get_recall(), best_ms * 1000 / query_size};
+        curve.push_back(point);
+        return point;
+    }
+
+public:
+    IVFAutotuner(int dim, int k_val, float* base, int base_num, const float* queries, int query_num, int reps = 3) :
+    vector_dim(dim), k(k_val), base_data(base), base_size(base_num), query_data(queries), query_size(query_num),
+    repetitions(reps), exact(static_cast<size_t>(query_num) * k_val) {
+        ANNS ann(vector_dim, k, query_data, base_data, query_size, base_size);
+        ann.brute_knn();
+        std::copy(ann.get_dist_lists(), ann.get_dist_lists() + exact.size(), exact.begin());
+    }
+
+    // Returns the index of the fastest point meeting target in get_curve(), -1 if none does
+    int tune(double target, const std::vector<int>& cluster_counts) {
+        curve.clear();
+        best = -1;
+        ANNS ann(vector_dim, k, query_data, base_data, query_size, base_size);
+
+        for (int num_clusters : cluster_counts) {
+            if (num_clusters < 1 || num_clusters > base_size) continue;
+            KMeans kmeans(num_clusters, vector_dim, base_data, base_size);
+            std::vector<std::vector<int>> ivf = kmeans.build_index();
+            const float* clusters = kmeans.get_clusters();
+
+            // smallest knn_cluster in [lo, hi] with recall >= target
+            int lo = 1, hi = num_clusters;
+            if (measure(ann, clusters, ivf, num_clusters, hi).recall < target) continue;
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                if (measure(ann, clusters, ivf, num_clusters, mid).recall >= target) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+
+            for (size_t i = 0; i < curve.size(); ++i) {
+                const tune_point_t& p = curve[i];
+                if (p.num_clusters == num_clusters && p.knn_cluster == hi &&
+                    (best < 0 || p.latency_us < curve[best].latency_us)) {
+                    best = static_cast<int>(i);
+                }
+            }
+        }
+        return best;
+    }
+
+    const std::vector<tune_point_t>& get_curve() const {
+        return curve;
+    }
+
+    // Curve sorted by latency, keeping only points no faster point beats on recall
+    std::vector<tune_point_t> get_pareto() const {
+        std::vector<tune_point_t> sorted = curve;
+        std::sort(sorted.begin(), sorted.end(), [](const tune_point_t& a, const tune_point_t& b) {
+            return a.latency_us < b.latency_us;
+        });
+        std::vector<tune_point_t> front;
+        for (const tune_point_t& p : sorted) {
+            if (front.empty() || p.recall > front.back().recall) front.push_back(p);
+        }
+        return front;
+    }
+
+    bool has_best() const {
+        return best >= 0;
+    }
+
+    tune_point_t get_best() const {
+        return best >= 0 ? curve[best] : tune_point_t{0, 0, 0.0, 0.0};
+    }
+
+    const int* get_exact() const {
+        return exact.data();
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+#include "distance.hpp"
+
+#include <omp.h>
+
+// 1 bit per dimension: bit j is set when x[j] > threshold[j]. Thresholds are
+// the per-dimension means of the training set, i.e. the sign of the centred
+// vector. A 768-d float vector (3 KB) becomes 96 bytes.
+class BinaryQuantizer {
+private:
+    int vector_dim;
+    int num_words;
+    std::vector<float> thresholds;
+
+public:
+    BinaryQuantizer(int dim) : vector_dim(dim), num_words((dim + 63) / 64), thresholds(dim, 0.0f) {}
+
+    void train(const float* data, int num_points) {
+        std::vector<double> sum(vector_dim, 0.0);
+        for (int i = 0; i < num_points; ++i) {
+            const float* vec = data + static_cast<size_t>(i) * vector_dim;
+            for (int j = 0; j < vector_dim; ++j) sum[j] += vec[j];
+        }
+        for (int j = 0; j < vector_dim; ++j) {
+            thresholds[j] = num_points > 0 ? static_cast<float>(sum[j] / num_points) : 0.0f;
+        }
+    }
+
+    void encode_one(const float* vec, uint64_t* code) const {
+        memset(code, 0, num_words * sizeof(uint64_t));
+        for (int j = 0; j < vector_dim; ++j) {
+            if (vec[j] > thresholds[j]) code[j >> 6] |= 1ULL << (j & 63);
+        }
+    }
+
+    // codes: num_points * num_words words
+    void encode(const float* data, int num_points, uint64_t* codes) const {
+        #pragma omp parallel for
+        for (int i = 0; i < num_points; ++i) {
+            encode_one(data + static_cast<size_t>(i) * vector_dim, codes + static_cast<size_t>(i) * num_words);
+        }
+    }
+
+    int get_num_words() const {
+        return num_words;
+    }
+};
+
+// Binary codes of a whole base set, row i is the code of data row i
+class BinaryCodes {
+private:
+    int num_points;
+    int num_words;
+    uint64_t* codes = nullptr;
+
+public:
+    BinaryCodes(const BinaryQuantizer& quantizer, const float* data, int data_size) :
+    num_points(data_size), num_words(quantizer.get_num_words()) {
+        size_t bytes = static_cast<size_t>(num_points) * num_words * sizeof(uint64_t);
+        codes = static_cast<uint64_t*>(aligned_alloc(64, (bytes + 63) / 64 * 64));
+        if (!codes) throw std::bad_alloc();
+        quantizer.encode(data, num_points, codes);
+    }
+
+    ~BinaryCodes() {
+        free(codes);
+    }
+
+    BinaryCodes(const BinaryCodes&) = delete;
+    BinaryCodes& operator=(const BinaryCodes&) = delete;
+
+    const uint64_t* get_code(int id) const {
+        return codes + static_cast<size_t>(id) * num_words;
+    }
+
+    int get_num_words() const {
+        return num_words;
+    }
+
+    size_t get_bytes() const {
+        return static_cast<size_t>(num_points) * num_words * sizeof(uint64_t);
+    }
+};
@@ -5,6 +5,7 @@
 #include <string>
 #include <cstdlib>
 #include <new>    
+#include "numa.hpp"
 
 template <typename T>
 class GraphData {
@@ -14,8 +15,38 @@ private:
     int num_vectors = 0;  
     T* data_vecs = nullptr;
 
+    NumaMode numa_mode = NUMA_OFF;
+    NumaShards shards;
+
+    size_t data_bytes() const {
+        return static_cast<size_t>(num_vectors) * vector_dim * sizeof(T);
+    }
+
+    // Pages are placed by policy before the loader first touches them
+    T* allocate() {
+        if (numa_mode == NUMA_OFF) {
+            return static_cast<T*>(aligned_alloc(32, num_vectors * vector_dim * sizeof(T)));
+        }
+
+        size_t page = 0;
+        T* data = static_cast<T*>(numa_alloc(data_bytes(), &page));
+        const NumaTopology& topo = shards.topo;
+        if (numa_mode == NUMA_INTERLEAVE) {
+            numa_bind(data, data_bytes(), MPOL_INTERLEAVE, topo.get_all_mask(), page);
+        } else {
+            shards = NumaShards(num_vectors);
+            for (int n = 0; n < shards.get_num_shards(); ++n) {
+                size_t row_bytes = static_cast<size_t>(vector_dim) * sizeof(T);
+                T* begin = data + static_cast<size_t>(shards.row_begin[n]) * vector_dim;
+                size_t bytes = (shards.row_begin[n + 1] - shards.row_begin[n]) * row_bytes;
+                if (bytes > 0) numa_bind(begin, bytes, MPOL_BIND, topo.get_mask(n), page);
+            }
+        }
+        return data;
+    }
+
 public:
-    GraphData(const std::string& file) : filename(file) {
+    GraphData(const std::string& file, NumaMode mode = NUMA_OFF) : filename(file), numa_mode(mode) {
         if (file.find("fvecs") != std::string::npos) {
             load_fvecs();
         } else if (file.find("ivecs") != std::string::npos) {
@@ -26,7 +57,11 @@ public:
     }
 
     ~GraphData() {
-        free(data_vecs); 
+        if (numa_mode == NUMA_OFF) {
+            free(data_vecs);
+        } else {
+            numa_free(data_vecs, data_bytes());
+        }
     }
 
     void load_fvecs() {
@@ -44,7 +79,7 @@ public:
             vector_dim = current_dim; 
         }
 
-        data_vecs = static_cast<T*>(aligned_alloc(32, num_vectors * vector_dim * sizeof(T)));
+        data_vecs = allocate();
         if (!data_vecs) throw std::bad_alloc(); 
 
         input.clear();
@@ -73,7 +108,7 @@ public:
             vector_dim = current_dim; 
         }
 
-        data_vecs = static_cast<T*>(aligned_alloc(32, num_vectors * vector_dim * sizeof(T)));
+        data_vecs = allocate();
         if (!data_vecs) throw std::bad_alloc();
 
         input.clear();
@@ -99,6 +134,11 @@ public:
         return num_vectors;
     }
 
+    // Row ranges per node, only meaningful in NUMA_SHARD mode
+    const NumaShards& get_shards() const {
+        return shards;
+    }
+
     void print_vectors(int num_sample = 10) const {     
         std::cout << "Number of samples: " << num_sample << std::endl;
 
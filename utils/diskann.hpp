@@ -0,0 +1,745 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "distance.hpp"
+#include "pqueue.hpp"
+#include "kmeans.hpp"
+#include "pq.hpp"
+#include "uring.hpp"
+#include "search_context.hpp"
+
+#include <omp.h>
+
+#define SECTOR_LEN 4096
+#define DISK_INDEX_MAGIC 0x414e4e5344534b31ULL // "ANNSDSK1"
+
+// Sector 0 of the index file. Sectors 1.. hold node records, nodes_per_sector
+// per sector, in id order. The PQ codebooks and codes follow at pq_offset.
+// Node record: dim floats | uint32 degree | max_degree uint32 neighbours,
+// padded to a multiple of 32 bytes so the vector stays aligned in the sector.
+struct disk_header_t {
+    uint64_t magic;
+    int32_t num_points;
+    int32_t dim;
+    int32_t max_degree;
+    int32_t medoid;
+    int32_t node_len;
+    int32_t nodes_per_sector;
+    int32_t pq_subspaces;
+    int32_t reserved;
+    uint64_t pq_offset;
+};
+
+struct vamana_params_t {
+    int max_degree = 32;          // R
+    int build_L = 64;             // search list size while building
+    float alpha = 1.2f;           // prune slack, > 1 keeps long range edges
+    size_t memory_budget_mb = 1024;
+    int pq_subspaces = 16;        // bytes per in-memory code
+    int pq_sample = 100000;
+};
+
+// Point closest to the mean, used as the search entry point
+inline uint32_t find_medoid(const float* data, int num_points, int dim) {
+    std::vector<double> mean(dim, 0.0);
+    for (int i = 0; i < num_points; ++i) {
+        for (int j = 0; j < dim; ++j) mean[j] += data[static_cast<size_t>(i) * dim + j];
+    }
+    uint32_t medoid = 0;
+    float best = FLT_MAX;
+    for (int i = 0; i < num_points; ++i) {
+        float dist = 0;
+        for (int j = 0; j < dim; ++j) {
+            float diff = data[static_cast<size_t>(i) * dim + j] - static_cast<float>(mean[j] / num_points);
+            dist += diff * diff;
+        }
+        if (dist < best) {
+            best = dist;
+            medoid = i;
+        }
+    }
+    return medoid;
+}
+
+// Vamana graph over an in-memory, 32-byte aligned block of vectors
+class VamanaGraph {
+private:
+    const float* data;
+    int num_points;
+    int dim;
+    int max_degree;
+    int build_L;
+    float alpha;
+
+    std::vector<std::vector<uint32_t>> graph;
+    std::vector<std::mutex> locks;
+    uint32_t medoid = 0;
+
+    float distance(uint32_t a, uint32_t b) const {
+        return compute_distance_squared(dim, data + static_cast<size_t>(a) * dim, data + static_cast<size_t>(b) * dim);
+    }
+
+    // Best-first search from the medoid. Returns every expanded node with its distance.
+    void greedy_search(const float* query, std::vector<std::pair<float, uint32_t>>& visited) {
+        SearchContext& ctx = thread_search_context();
+        pqueue_t<uint32_t>& Q = ctx.frontier;
+        Q.reset(build_L);
+        VisitedSet& seen = ctx.visited;
+        seen.clear();
+        std::vector<uint32_t> neighbours;
+
+        Q.push(medoid, compute_distance_squared(dim, query, data + static_cast<size_t>(medoid) * dim));
+        seen.insert(medoid);
+
+        uint32_t node;
+        while (Q.pop_unexpanded(1, &node) == 1) {
+            visited.push_back(std::make_pair(compute_distance_squared(dim, query, data + static_cast<size_t>(node) * dim), node));
+            {
+                std::lock_guard<std::mutex> guard(locks[node]);
+                neighbours = graph[node];
+            }
+            uint32_t* fresh = ctx.nodes(neighbours.size());
+            int num_fresh = 0;
+            for (uint32_t nbr : neighbours) {
+                if (seen.insert(nbr)) fresh[num_fresh++] = nbr;
+            }
+            float* dists = ctx.floats(num_fresh);
+            compute_distances_batch(dim, query, data, fresh, num_fresh, dists);
+            Q.batch_push(fresh, dists, num_fresh, ctx.scored_nodes);
+        }
+    }
+
+    // Keeps the closest candidate, drops every candidate it "covers" by a factor
+    // alpha, and repeats until max_degree neighbours are chosen
+    std::vector<uint32_t> robust_prune(uint32_t p, std::vector<std::pair<float, uint32_t>>& candidates, float a) const {
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                         [](const std::pair<float, uint32_t>& x, const std::pair<float, uint32_t>& y) { return x.second == y.second; }),
+                         candidates.end());
+
+        std::vector<uint32_t> result;
+        std::vector<uint8_t> removed(candidates.size(), 0);
+        for (size_t i = 0; i < candidates.size() && static_cast<int>(result.size()) < max_degree; ++i) {
+            if (removed[i] || candidates[i].second == p) continue;
+            uint32_t chosen = candidates[i].second;
+            result.push_back(chosen);
+            for (size_t j = i + 1; j < candidates.size(); ++j) {
+                if (removed[j]) continue;
+                if (a * distance(chosen, candidates[j].second) <= candidates[j].first) removed[j] = 1;
+            }
+        }
+        return result;
+    }
+
+    void prune_neighbours(uint32_t p, float a) {
+        std::vector<std::pair<float, uint32_t>> candidates;
+        for (uint32_t nbr : graph[p]) candidates.push_back(std::make_pair(distance(p, nbr), nbr));
+        graph[p] = robust_prune(p, candidates, a);
+    }
+
+    void build_pass(float a, const std::vector<uint32_t>& order) {
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (size_t o = 0; o < order.size(); ++o) {
+            uint32_t p = order[o];
+            const float* point = data + static_cast<size_t>(p) * dim;
+            std::vector<std::pair<float, uint32_t>> candidates;
+            greedy_search(point, candidates);
+
+            std::vector<uint32_t> neighbours;
+            {
+                std::lock_guard<std::mutex> guard(locks[p]);
+                for (uint32_t nbr : graph[p]) candidates.push_back(std::make_pair(distance(p, nbr), nbr));
+                neighbours = robust_prune(p, candidates, a);
+                graph[p] = neighbours;
+            }
+
+            // back edges, pruning any list that overflows
+            for (uint32_t nbr : neighbours) {
+                std::lock_guard<std::mutex> guard(locks[nbr]);
+                std::vector<uint32_t>& list = graph[nbr];
+                if (std::find(list.begin(), list.end(), p) != list.end()) continue;
+                list.push_back(p);
+                if (static_cast<int>(list.size()) > max_degree) prune_neighbours(nbr, a);
+            }
+        }
+    }
+
+public:
+    VamanaGraph(const float* vecs, int n, int d, const vamana_params_t& params) :
+    data(vecs), num_points(n), dim(d), max_degree(params.max_degree), build_L(params.build_L),
+    alpha(params.alpha), graph(n), locks(n) {}
+
+    void build() {
+        if (num_points == 0) return;
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<uint32_t> distr(0, num_points - 1);
+        int init_degree = std::min(max_degree, num_points - 1);
+        for (int i = 0; i < num_points; ++i) {
+            while (static_cast<int>(graph[i].size()) < init_degree) {
+                uint32_t nbr = distr(gen);
+                if (nbr != static_cast<uint32_t>(i) && std::find(graph[i].begin(), graph[i].end(), nbr) == graph[i].end()) {
+                    graph[i].push_back(nbr);
+                }
+            }
+        }
+        medoid = find_medoid(data, num_points, dim);
+
+        std::vector<uint32_t> order(num_points);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), gen);
+        build_pass(1.0f, order);
+        build_pass(alpha, order);
+    }
+
+    std::vector<uint32_t> prune(uint32_t p, std::vector<std::pair<float, uint32_t>>& candidates) const {
+        return robust_prune(p, candidates, alpha);
+    }
+
+    const std::vector<uint32_t>& neighbours(uint32_t p) const {
+        return graph[p];
+    }
+};
+
+// SSD resident Vamana index (DiskANN layout). Only the PQ codes live in RAM;
+// each search hop reads the sectors of W frontier nodes at once, which hold
+// both their neighbour lists and full vectors for exact re-ranking.
+class DiskIndex {
+private:
+    std::string filename;
+    int fd = -1;
+    disk_header_t header;
+
+    ProductQuantizer* pq = nullptr;
+    std::vector<uint8_t> pq_codes;
+
+    double runtime = 0.0;
+    double mean_ios = 0.0;
+    double mean_hops = 0.0;
+
+    static size_t sector_offset(const disk_header_t& h, uint32_t node) {
+        return (1 + static_cast<size_t>(node) / h.nodes_per_sector) * SECTOR_LEN;
+    }
+
+    // pread until len bytes are in, false on a short file or I/O error
+    static bool pread_full(int file, void* buf, size_t len, off_t offset) {
+        size_t got = 0;
+        while (got < len) {
+            ssize_t n = pread(file, static_cast<char*>(buf) + got, len - got, offset + static_cast<off_t>(got));
+            if (n <= 0) return false;
+            got += n;
+        }
+        return true;
+    }
+
+public:
+    // Builds from an .fvecs file without loading it. Every stage is sized by
+    // memory_budget_mb:
+    //  1. a sample spread over the file trains the partition centroids and the PQ
+    //  2. one stream over the base writes each row to the vector files of its
+    //     two closest partitions, sized so one partition's graph fits the budget
+    //  3. a Vamana graph is built per partition and spilled by global id
+    //  4. the graphs are merged by id range, one budget-sized range at a time;
+    //     each range's rows are streamed in for the sectors, PQ codes and medoid
+    // Only the pruning of an overflowing union reads vectors at random.
+    static bool build(const std::string& index_file, const std::string& base_file, const vamana_params_t& params) {
+        auto start = std::chrono::high_resolution_clock::now();
+        int R = params.max_degree;
+
+        int in = open(base_file.c_str(), O_RDONLY);
+        if (in < 0) {
+            std::cerr << "Error opening file: " << base_file << std::endl;
+            return false;
+        }
+        posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+        int dim = 0;
+        struct stat st;
+        if (fstat(in, &st) != 0 || !pread_full(in, &dim, sizeof(int), 0) || dim <= 0 || dim % 8 != 0) {
+            std::cerr << "Base vectors need a dim that is a positive multiple of 8: " << base_file << std::endl;
+            close(in);
+            return false;
+        }
+        if (!ProductQuantizer::supports(dim, params.pq_subspaces)) {
+            std::cerr << "PQ needs dim / pq_subspaces to be a multiple of 8, got " << dim << " / "
+                      << params.pq_subspaces << std::endl;
+            close(in);
+            return false;
+        }
+        const size_t row_bytes = sizeof(int) + dim * sizeof(float);   // fvecs record
+        long long total_rows = st.st_size / static_cast<long long>(row_bytes);
+        if (total_rows <= 0 || total_rows > INT32_MAX) {
+            std::cerr << "Unsupported number of base vectors: " << total_rows << std::endl;
+            close(in);
+            return false;
+        }
+        int num_points = static_cast<int>(total_rows);
+        auto row_offset = [&](size_t id) { return static_cast<off_t>(id * row_bytes + sizeof(int)); };
+
+        disk_header_t h;
+        memset(&h, 0, sizeof(h));
+        h.magic = DISK_INDEX_MAGIC;
+        h.num_points = num_points;
+        h.dim = dim;
+        h.max_degree = R;
+        h.node_len = static_cast<int32_t>((dim * sizeof(float) + (R + 1) * sizeof(uint32_t) + 31) / 32 * 32);
+        h.nodes_per_sector = SECTOR_LEN / h.node_len;
+        h.pq_subspaces = params.pq_subspaces;
+        if (h.nodes_per_sector == 0) {
+            std::cerr << "Node record of " << h.node_len << " bytes does not fit a sector" << std::endl;
+            close(in);
+            return false;
+        }
+        size_t num_sectors = (static_cast<size_t>(num_points) + h.nodes_per_sector - 1) / h.nodes_per_sector;
+        h.pq_offset = (1 + num_sectors) * SECTOR_LEN;
+
+        size_t budget = params.memory_budget_mb << 20;
+        size_t point_bytes = dim * sizeof(float) + R * sizeof(uint32_t) * 2 + 64;
+        int num_parts = static_cast<int>(std::max<size_t>(1, (2 * point_bytes * num_points + budget - 1) / budget));
+        int overlap = num_parts > 1 ? 2 : 1;
+
+        // Sample, also the PQ training set
+        int num_samples = std::min(num_points, params.pq_sample);
+        float* sample = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(num_samples) * dim * sizeof(float)));
+        if (!sample) throw std::bad_alloc();
+        bool read_ok = true;
+        for (int i = 0; i < num_samples && read_ok; ++i) {
+            size_t src = static_cast<size_t>(i) * num_points / num_samples;
+            read_ok = pread_full(in, sample + static_cast<size_t>(i) * dim, dim * sizeof(float), row_offset(src));
+        }
+        std::vector<float> centroids;
+        if (read_ok && num_parts > 1) {
+            KMeans kmeans(num_parts, dim, sample, num_samples);
+            kmeans.train(10);
+            centroids.assign(kmeans.get_clusters(), kmeans.get_clusters() + static_cast<size_t>(num_parts) * dim);
+        }
+        ProductQuantizer quantizer(dim, params.pq_subspaces);
+        if (read_ok) quantizer.train(sample, num_samples, num_samples);
+        free(sample);
+        if (!read_ok) {
+            std::cerr << "Error reading file: " << base_file << std::endl;
+            close(in);
+            return false;
+        }
+
+        // Assignment pass: rows go, with their id, to per partition vector files
+        size_t chunk_rows = std::max<size_t>(1, budget / 4 / row_bytes);
+        char* chunk = static_cast<char*>(aligned_alloc(4096, (chunk_rows * row_bytes + 4095) / 4096 * 4096));
+        if (!chunk) throw std::bad_alloc();
+        std::vector<std::string> part_names(num_parts);
+        std::vector<std::ofstream> part_out(num_parts);
+        std::vector<size_t> part_size(num_parts, 0);
+        for (int p = 0; p < num_parts; ++p) {
+            part_names[p] = index_file + ".part" + std::to_string(p);
+            part_out[p].open(part_names[p], std::ios::binary | std::ios::trunc);
+            if (!part_out[p]) {
+                std::cerr << "Error opening file: " << part_names[p] << std::endl;
+                read_ok = false;
+            }
+        }
+        std::vector<double> mean(dim, 0.0);
+        std::vector<int> part_ids(num_parts);
+        std::iota(part_ids.begin(), part_ids.end(), 0);
+        std::vector<int> nearest(chunk_rows * overlap);
+        for (size_t first = 0; first < static_cast<size_t>(num_points) && read_ok; first += chunk_rows) {
+            size_t n = std::min(chunk_rows, num_points - first);
+            if (!pread_full(in, chunk, n * row_bytes, static_cast<off_t>(first * row_bytes))) {
+                std::cerr << "Error reading file: " << base_file << std::endl;
+                read_ok = false;
+                break;
+            }
+            if (num_parts > 1) {
+                #pragma omp parallel
+                {
+                    std::vector<float> dists(num_parts);
+                    pqueue_t<int> C(overlap);
+                    #pragma omp for
+                    for (size_t r = 0; r < n; ++r) {
+                        const float* row = reinterpret_cast<const float*>(chunk + r * row_bytes + sizeof(int));
+                        compute_distances_batch(dim, row, centroids.data(), part_ids.data(), num_parts, dists.data());
+                        C.reset(overlap);
+                        for (int c = 0; c < num_parts; ++c) C.push(c, dists[c]);
+                        for (int o = 0; o < overlap; ++o) nearest[r * overlap + o] = C[o];
+                    }
+                }
+            }
+            for (size_t r = 0; r < n; ++r) {
+                uint32_t id = static_cast<uint32_t>(first + r);
+                const char* row = chunk + r * row_bytes + sizeof(int);
+                const float* vec = reinterpret_cast<const float*>(row);
+                for (int j = 0; j < dim; ++j) mean[j] += vec[j];
+                for (int o = 0; o < overlap; ++o) {
+                    int p = num_parts > 1 ? nearest[r * overlap + o] : 0;
+                    part_out[p].write(reinterpret_cast<const char*>(&id), sizeof(uint32_t));
+                    part_out[p].write(row, dim * sizeof(float));
+                    part_size[p]++;
+                }
+            }
+        }
+        for (int p = 0; p < num_parts; ++p) {
+            part_out[p].close();
+            if (part_out[p].fail()) read_ok = false;
+        }
+        free(chunk);
+
+        // Per partition graphs, spilled to a temp file as (id, degree, neighbours)
+        std::string part_file = index_file + ".parts";
+        std::ofstream spill(part_file, std::ios::binary);
+        if (!spill) {
+            std::cerr << "Error opening file: " << part_file << std::endl;
+            read_ok = false;
+        }
+        for (int p = 0; p < num_parts && read_ok; ++p) {
+            size_t size = part_size[p];
+            std::vector<uint32_t> ids(size);
+            float* local = static_cast<float*>(aligned_alloc(32, std::max<size_t>(1, size) * dim * sizeof(float)));
+            if (!local) throw std::bad_alloc();
+            std::ifstream part_in(part_names[p], std::ios::binary);
+            for (size_t i = 0; i < size && part_in; ++i) {
+                part_in.read(reinterpret_cast<char*>(&ids[i]), sizeof(uint32_t));
+                part_in.read(reinterpret_cast<char*>(local + i * dim), dim * sizeof(float));
+            }
+            if (!part_in) {
+                std::cerr << "Error reading file: " << part_names[p] << std::endl;
+                free(local);
+                read_ok = false;
+                break;
+            }
+            part_in.close();
+            std::remove(part_names[p].c_str());
+
+            VamanaGraph graph(local, static_cast<int>(size), dim, params);
+            graph.build();
+            for (size_t i = 0; i < size; ++i) {
+                const std::vector<uint32_t>& nbrs = graph.neighbours(i);
+                uint32_t degree = static_cast<uint32_t>(nbrs.size());
+                spill.write(reinterpret_cast<const char*>(&ids[i]), sizeof(uint32_t));
+                spill.write(reinterpret_cast<const char*>(&degree), sizeof(uint32_t));
+                for (uint32_t nbr : nbrs) {
+                    uint32_t global = ids[nbr];
+                    spill.write(reinterpret_cast<const char*>(&global), sizeof(uint32_t));
+                }
+            }
+            free(local);
+        }
+        spill.close();
+        for (const std::string& name : part_names) std::remove(name.c_str());
+
+        std::ofstream output(index_file, std::ios::binary | std::ios::trunc);
+        std::string codes_file = index_file + ".codes";
+        std::ofstream codes_out(codes_file, std::ios::binary | std::ios::trunc);
+        if (read_ok && (!output || !codes_out)) {
+            std::cerr << "Error opening file: " << index_file << std::endl;
+            read_ok = false;
+        }
+        if (!read_ok) {
+            close(in);
+            std::remove(part_file.c_str());
+            std::remove(codes_file.c_str());
+            return false;
+        }
+        std::vector<char> sector(SECTOR_LEN, 0);
+        output.write(sector.data(), SECTOR_LEN);   // header, written once the medoid is known
+
+        float* centre = static_cast<float*>(aligned_alloc(32, dim * sizeof(float)));
+        if (!centre) throw std::bad_alloc();
+        for (int j = 0; j < dim; ++j) centre[j] = static_cast<float>(mean[j] / num_points);
+        float medoid_dist = FLT_MAX;
+
+        // Merge by id range, one pass over the spill file per range
+        size_t range_len = std::max<size_t>(h.nodes_per_sector,
+                                            budget / (R * sizeof(uint32_t) * overlap * 2 + 2 * row_bytes + 64 + h.pq_subspaces));
+        range_len = range_len / h.nodes_per_sector * h.nodes_per_sector;
+        char* raw = static_cast<char*>(aligned_alloc(4096, (range_len * row_bytes + 4095) / 4096 * 4096));
+        float* vecs = static_cast<float*>(aligned_alloc(32, range_len * dim * sizeof(float)));
+        if (!raw || !vecs) throw std::bad_alloc();
+        std::vector<uint8_t> codes(range_len * h.pq_subspaces);
+
+        for (size_t begin = 0; begin < static_cast<size_t>(num_points) && read_ok; begin += range_len) {
+            size_t end = std::min<size_t>(num_points, begin + range_len);
+            if (!pread_full(in, raw, (end - begin) * row_bytes, static_cast<off_t>(begin * row_bytes))) {
+                read_ok = false;
+                break;
+            }
+            for (size_t i = 0; i < end - begin; ++i) {
+                memcpy(vecs + i * dim, raw + i * row_bytes + sizeof(int), dim * sizeof(float));
+            }
+            auto vector_of = [&](size_t id) { return vecs + (id - begin) * dim; };
+
+            std::vector<std::vector<uint32_t>> lists(end - begin);
+            std::ifstream input(part_file, std::ios::binary);
+            uint32_t id, degree;
+            std::vector<uint32_t> nbrs;
+            while (input.read(reinterpret_cast<char*>(&id), sizeof(uint32_t))) {
+                input.read(reinterpret_cast<char*>(&degree), sizeof(uint32_t));
+                nbrs.resize(degree);
+                input.read(reinterpret_cast<char*>(nbrs.data()), degree * sizeof(uint32_t));
+                if (id < begin || id >= end) continue;
+                std::vector<uint32_t>& list = lists[id - begin];
+                for (uint32_t nbr : nbrs) {
+                    if (std::find(list.begin(), list.end(), nbr) == list.end()) list.push_back(nbr);
+                }
+            }
+
+            std::atomic<bool> prune_ok(true);
+            #pragma omp parallel for schedule(dynamic, 64)
+            for (size_t i = begin; i < end; ++i) {
+                std::vector<uint32_t>& list = lists[i - begin];
+                if (static_cast<int>(list.size()) <= R) continue;
+                // Prune the union over the global vectors, read from the file when outside the range
+                std::vector<uint32_t> ids(1, static_cast<uint32_t>(i));
+                ids.insert(ids.end(), list.begin(), list.end());
+                float* local = static_cast<float*>(aligned_alloc(32, ids.size() * dim * sizeof(float)));
+                if (!local) throw std::bad_alloc();
+                for (size_t j = 0; j < ids.size(); ++j) {
+                    if (ids[j] >= begin && ids[j] < end) {
+                        memcpy(local + j * dim, vector_of(ids[j]), dim * sizeof(float));
+                    } else if (!pread_full(in, local + j * dim, dim * sizeof(float), row_offset(ids[j]))) {
+                        prune_ok = false;
+                    }
+                }
+                VamanaGraph pruner(local, static_cast<int>(ids.size()), dim, params);
+                std::vector<std::pair<float, uint32_t>> candidates;
+                for (size_t j = 1; j < ids.size(); ++j) {
+                    candidates.push_back(std::make_pair(compute_distance_squared(dim, local, local + j * dim), static_cast<uint32_t>(j)));
+                }
+                std::vector<uint32_t> kept = pruner.prune(0, candidates);
+                list.clear();
+                for (uint32_t j : kept) list.push_back(ids[j]);
+                free(local);
+            }
+            if (!prune_ok) {
+                read_ok = false;
+                break;
+            }
+
+            for (size_t i = begin; i < end; ++i) {
+                float dist = compute_distance_squared(dim, vector_of(i), centre);
+                if (dist < medoid_dist) {
+                    medoid_dist = dist;
+                    h.medoid = static_cast<int32_t>(i);
+                }
+            }
+            quantizer.encode(vecs, static_cast<int>(end - begin), codes.data());
+            codes_out.write(reinterpret_cast<const char*>(codes.data()), (end - begin) * h.pq_subspaces);
+
+            for (size_t first_node = begin; first_node < end; first_node += h.nodes_per_sector) {
+                std::fill(sector.begin(), sector.end(), 0);
+                for (size_t i = first_node; i < std::min(end, first_node + h.nodes_per_sector); ++i) {
+                    char* record = sector.data() + (i - first_node) * h.node_len;
+                    const std::vector<uint32_t>& list = lists[i - begin];
+                    uint32_t degree_out = static_cast<uint32_t>(list.size());
+                    memcpy(record, vector_of(i), dim * sizeof(float));
+                    memcpy(record + dim * sizeof(float), &degree_out, sizeof(uint32_t));
+                    memcpy(record + dim * sizeof(float) + sizeof(uint32_t), list.data(), list.size() * sizeof(uint32_t));
+                }
+                output.write(sector.data(), SECTOR_LEN);
+            }
+        }
+        free(raw);
+        free(vecs);
+        free(centre);
+        close(in);
+        std::remove(part_file.c_str());
+        codes_out.close();
+        if (!read_ok) {
+            std::cerr << "Error reading file: " << base_file << std::endl;
+            std::remove(codes_file.c_str());
+            return false;
+        }
+
+        // PQ section: codebooks, then the codes copied over from the temp file
+        output.write(reinterpret_cast<const char*>(quantizer.get_codebooks()), quantizer.codebook_size() * sizeof(float));
+        std::ifstream codes_in(codes_file, std::ios::binary);
+        std::vector<char> copy(1 << 20);
+        while (codes_in.read(copy.data(), copy.size()) || codes_in.gcount() > 0) output.write(copy.data(), codes_in.gcount());
+        codes_in.close();
+        std::remove(codes_file.c_str());
+
+        memcpy(sector.data(), &h, sizeof(h));
+        output.seekp(0);
+        output.write(sector.data(), sizeof(h));
+        output.close();
+        if (output.fail()) {
+            std::cerr << "Error writing file: " << index_file << std::endl;
+            return false;
+        }
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        std::cout << "Disk index built in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << "ms ("
+                  << num_parts << " partitions)" << std::endl;
+        return true;
+    }
+
+    DiskIndex(const std::string& file) : filename(file) {
+        memset(&header, 0, sizeof(header));
+        std::ifstream input(filename, std::ios::binary);
+        if (!input) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return;
+        }
+        input.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!input || header.magic != DISK_INDEX_MAGIC || header.num_points <= 0 || header.dim <= 0 ||
+            header.max_degree < 0 || header.medoid < 0 || header.medoid >= header.num_points ||
+            header.nodes_per_sector <= 0 || header.pq_subspaces <= 0 ||
+            !ProductQuantizer::supports(header.dim, header.pq_subspaces) ||
+            header.node_len < static_cast<int32_t>(header.dim * sizeof(float) + (header.max_degree + 1) * sizeof(uint32_t)) ||
+            static_cast<long>(header.node_len) * header.nodes_per_sector > SECTOR_LEN) {
+            std::cerr << "Not a disk index: " << filename << std::endl;
+            memset(&header, 0, sizeof(header));
+            return;
+        }
+
+        pq = new ProductQuantizer(header.dim, header.pq_subspaces);
+        pq_codes.resize(static_cast<size_t>(header.num_points) * header.pq_subspaces);
+        input.seekg(header.pq_offset, std::ios::beg);
+        input.read(reinterpret_cast<char*>(pq->get_codebooks()), pq->codebook_size() * sizeof(float));
+        input.read(reinterpret_cast<char*>(pq_codes.data()), pq_codes.size());
+        if (!input) {
+            std::cerr << "Truncated disk index: " << filename << std::endl;
+            delete pq;
+            pq = nullptr;
+            std::vector<uint8_t>().swap(pq_codes);
+            return;
+        }
+        input.close();
+
+        // Bypass the page cache so reads measure the device; not every
+        // filesystem (e.g. tmpfs) supports it
+        fd = open(filename.c_str(), O_RDONLY | O_DIRECT);
+        if (fd < 0) fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) std::cerr << "Error opening file: " << filename << std::endl;
+    }
+
+    // False if the file was missing, not an index or truncated; search then returns only -1
+    bool ok() const {
+        return pq != nullptr && fd >= 0;
+    }
+
+    ~DiskIndex() {
+        delete pq;
+        if (fd >= 0) close(fd);
+    }
+
+    // Beam search: L bounds the PQ-ordered candidate list, W is the number of
+    // sector reads issued together per hop. results: num_queries * k ids,
+    // padded with -1. A query whose sector reads fail stops where it is.
+    void search(const float* query_vecs, int num_queries, int k, int L, int W, int* results) {
+        auto start = std::chrono::high_resolution_clock::now();
+        long total_ios = 0, total_hops = 0, failed = 0;
+        const int m = header.pq_subspaces;
+        if (!ok()) {
+            std::fill(results, results + static_cast<size_t>(num_queries) * k, -1);
+            runtime = mean_ios = mean_hops = 0.0;
+            return;
+        }
+
+        #pragma omp parallel reduction(+:total_ios, total_hops, failed)
+        {
+            // ring, sector buffer and PQ table live in the thread's context across batches
+            SearchContext& ctx = thread_search_context();
+            SectorReader& reader = ctx.reader(fd, W);
+            char* sectors = ctx.io_buffer(static_cast<size_t>(W) * SECTOR_LEN);
+            float* table = ctx.floats(static_cast<size_t>(m) * PQ_CENTROIDS);
+            uint32_t* frontier = ctx.nodes(W);
+            std::vector<read_req_t>& reqs = ctx.reads;
+
+            #pragma omp for schedule(dynamic, 1)
+            for (int i = 0; i < num_queries; ++i) {
+                const float* query_ptr = query_vecs + static_cast<size_t>(i) * header.dim;
+                pq->compute_table(query_ptr, table);
+
+                pqueue_t<uint32_t>& Q = ctx.frontier;
+                Q.reset(L);
+                pqueue_t<int>& S = ctx.results;
+                S.reset(k);
+                VisitedSet& visited = ctx.visited;
+                visited.clear();
+                uint32_t entry = header.medoid;
+                Q.push(entry, pq->table_distance(table, &pq_codes[static_cast<size_t>(entry) * m]));
+                visited.insert(entry);
+
+                int count;
+                while ((count = Q.pop_unexpanded(W, frontier)) > 0) {
+                    reqs.clear();
+                    for (int w = 0; w < count; ++w) {
+                        reqs.push_back({sectors + static_cast<size_t>(w) * SECTOR_LEN, SECTOR_LEN,
+                                        static_cast<off_t>(sector_offset(header, frontier[w]))});
+                    }
+                    total_ios += count;
+                    total_hops++;
+                    if (!reader.read(reqs)) {
+                        failed++;
+                        break;
+                    }
+
+                    for (int w = 0; w < count; ++w) {
+                        const char* record = sectors + static_cast<size_t>(w) * SECTOR_LEN
+                                           + (frontier[w] % header.nodes_per_sector) * header.node_len;
+                        const float* vec = reinterpret_cast<const float*>(record);
+                        S.push(frontier[w], compute_distance_squared(header.dim, query_ptr, vec));
+
+                        uint32_t degree;
+                        memcpy(&degree, record + header.dim * sizeof(float), sizeof(uint32_t));
+                        degree = std::min<uint32_t>(degree, header.max_degree);
+                        const uint32_t* nbrs = reinterpret_cast<const uint32_t*>(record + header.dim * sizeof(float) + sizeof(uint32_t));
+                        for (uint32_t d = 0; d < degree; ++d) {
+                            uint32_t nbr = nbrs[d];
+                            if (nbr >= static_cast<uint32_t>(header.num_points) || !visited.insert(nbr)) continue;
+                            Q.push(nbr, pq->table_distance(table, &pq_codes[static_cast<size_t>(nbr) * m]));
+                        }
+                    }
+                }
+
+                int* out = results + static_cast<size_t>(i) * k;
+                for (int s = 0; s < k; ++s) {
+                    out[s] = s < S.size() ? S[s] : -1;
+                }
+            }
+        }
+
+        if (failed) std::cerr << failed << " queries stopped early on sector read errors: " << filename << std::endl;
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        mean_ios = num_queries > 0 ? static_cast<double>(total_ios) / num_queries : 0.0;
+        mean_hops = num_queries > 0 ? static_cast<double>(total_hops) / num_queries : 0.0;
+    }
+
+    int get_num_points() const {
+        return header.num_points;
+    }
+
+    size_t get_memory_bytes() const {
+        return pq_codes.size() + (pq ? pq->codebook_size() * sizeof(float) : 0);
+    }
+
+    double get_runtime() const {
+        return runtime;
+    }
+
+    double get_mean_ios() const {
+        return mean_ios;
+    }
+
+    double get_mean_hops() const {
+        return mean_hops;
+    }
+};
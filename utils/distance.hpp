@@ -75,3 +75,109 @@ inline float compute_distance_squared(int dim, const float* __restrict__ a, cons
   return _mm256_reduce_add_ps(sum);
 }
 
+
+
+// Squared L2 from one query to the rows data + ids[c] * dim, c < n, into out.
+// Rows are prefetched `ahead` candidates early so the random gathers overlap
+// with the arithmetic, and scored four at a time so every query load feeds
+// four FMAs. Unlike compute_distance_squared the rows need not be aligned and
+// a dim that is not a multiple of 8 is handled. A non-zero stride (in floats)
+// addresses rows as data + ids[c] * stride instead, e.g. raw fvecs records.
+template <typename Id>
+inline void compute_distances_batch(int dim, const float* __restrict__ query, const float* __restrict__ data,
+                                    const Id* __restrict__ ids, int n, float* __restrict__ out, int ahead = 8,
+                                    size_t stride = 0) {
+  const int row_bytes = dim * static_cast<int>(sizeof(float));
+  const size_t row_stride = stride ? stride : static_cast<size_t>(dim);
+  auto prefetch_row = [&](int c) {
+    const char* row = reinterpret_cast<const char*>(data + static_cast<size_t>(ids[c]) * row_stride);
+    for (int b = 0; b < row_bytes; b += 64) _mm_prefetch(row + b, _MM_HINT_T0);
+  };
+  for (int c = 0; c < std::min(n, ahead); c++) prefetch_row(c);
+
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (int c = i + ahead; c < std::min(n, i + ahead + 4); c++) prefetch_row(c);
+    const float* r0 = data + static_cast<size_t>(ids[i]) * row_stride;
+    const float* r1 = data + static_cast<size_t>(ids[i + 1]) * row_stride;
+    const float* r2 = data + static_cast<size_t>(ids[i + 2]) * row_stride;
+    const float* r3 = data + static_cast<size_t>(ids[i + 3]) * row_stride;
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= dim; j += 8) {
+      __m256 q = _mm256_loadu_ps(query + j);
+      __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(r0 + j), q);
+      __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(r1 + j), q);
+      __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(r2 + j), q);
+      __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(r3 + j), q);
+      s0 = _mm256_fmadd_ps(d0, d0, s0);
+      s1 = _mm256_fmadd_ps(d1, d1, s1);
+      s2 = _mm256_fmadd_ps(d2, d2, s2);
+      s3 = _mm256_fmadd_ps(d3, d3, s3);
+    }
+    float t0 = _mm256_reduce_add_ps(s0), t1 = _mm256_reduce_add_ps(s1);
+    float t2 = _mm256_reduce_add_ps(s2), t3 = _mm256_reduce_add_ps(s3);
+    for (; j < dim; j++) {
+      float d0 = r0[j] - query[j], d1 = r1[j] - query[j], d2 = r2[j] - query[j], d3 = r3[j] - query[j];
+      t0 += d0 * d0;
+      t1 += d1 * d1;
+      t2 += d2 * d2;
+      t3 += d3 * d3;
+    }
+    out[i] = t0;
+    out[i + 1] = t1;
+    out[i + 2] = t2;
+    out[i + 3] = t3;
+  }
+
+  for (; i < n; i++) {
+    const float* row = data + static_cast<size_t>(ids[i]) * row_stride;
+    __m256 sum = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= dim; j += 8) {
+      __m256 d = _mm256_sub_ps(_mm256_loadu_ps(row + j), _mm256_loadu_ps(query + j));
+      sum = _mm256_fmadd_ps(d, d, sum);
+    }
+    float t = _mm256_reduce_add_ps(sum);
+    for (; j < dim; j++) {
+      float d = row[j] - query[j];
+      t += d * d;
+    }
+    out[i] = t;
+  }
+}
+
+// Hamming distance between two bit codes of num_words 64-bit words
+inline int hamming_distance(const uint64_t* __restrict__ a, const uint64_t* __restrict__ b, int num_words) {
+  int i = 0;
+  int count = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+  __m512i sum512 = _mm512_setzero_si512();
+  for (; i + 8 <= num_words; i += 8) {
+    __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+    sum512 = _mm512_add_epi64(sum512, _mm512_popcnt_epi64(x));
+  }
+  alignas(64) uint64_t lanes[8];
+  _mm512_store_si512(lanes, sum512);
+  for (int j = 0; j < 8; ++j) count += static_cast<int>(lanes[j]);
+#endif
+#if defined(__AVX2__)
+  // nibble lookup popcount (Mula), summed per byte then per 64-bit lane
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i sum256 = _mm256_setzero_si256();
+  for (; i + 4 <= num_words; i += 4) {
+    __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+    sum256 = _mm256_add_epi64(sum256, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+  }
+  count += static_cast<int>(_mm256_extract_epi64(sum256, 0) + _mm256_extract_epi64(sum256, 1) +
+                            _mm256_extract_epi64(sum256, 2) + _mm256_extract_epi64(sum256, 3));
+#endif
+  for (; i < num_words; i++) {
+    count += __builtin_popcountll(a[i] ^ b[i]);
+  }
+  return count;
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <omp.h>
+
+#include "distance.hpp"
+
+struct gt_checkpoint_t {
+    uint32_t magic;
+    int num_queries;
+    int dim;
+    int k;
+    long long base_rows;
+    long long rows_done;
+};
+
+// Exact k-NN ground truth for a base file that does not fit in memory. The
+// base is streamed in chunks of raw fvecs rows: a reader thread fills one
+// buffer with pread while the OpenMP team scans the other. Each query keeps
+// a max-heap of (squared distance, id), ties broken by the smaller id so the
+// result does not depend on the chunk size. Progress is checkpointed every
+// few chunks and picked up again by a new generator on the same files.
+class GroundTruthGenerator {
+private:
+    static const uint32_t CHECKPOINT_MAGIC = 0x47544350;   // "GTCP"
+
+    std::string base_file;
+    std::string checkpoint_file;
+    const float* queries;
+    int num_queries;
+    int vector_dim;
+    int k;
+    int chunk_rows;
+    int checkpoint_every;
+
+    size_t row_bytes;
+    long long base_rows = 0;
+    long long rows_done = 0;
+    bool base_ok = false;
+    std::vector<std::vector<std::pair<float, int>>> heaps;
+
+    double runtime = 0;
+
+    bool load_checkpoint() {
+        std::ifstream input(checkpoint_file, std::ios::binary);
+        if (!input) return false;
+
+        gt_checkpoint_t header;
+        input.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!input || header.magic != CHECKPOINT_MAGIC || header.num_queries != num_queries ||
+            header.dim != vector_dim || header.k != k || header.base_rows != base_rows) {
+            std::cerr << "Ignoring stale checkpoint: " << checkpoint_file << std::endl;
+            return false;
+        }
+
+        bool valid = true;
+        for (auto& heap : heaps) {
+            int size = 0;
+            input.read(reinterpret_cast<char*>(&size), sizeof(int));
+            if (!input || size < 0 || size > k) {
+                valid = false;
+                break;
+            }
+            heap.resize(size);
+            input.read(reinterpret_cast<char*>(heap.data()), size * sizeof(std::pair<float, int>));
+        }
+        if (!valid || !input) {
+            std::cerr << "Ignoring truncated checkpoint: " << checkpoint_file << std::endl;
+            for (auto& heap : heaps) heap.clear();
+            return false;
+        }
+        rows_done = header.rows_done;
+        return true;
+    }
+
+    // Written to a temporary file and renamed, so a crash never leaves a torn checkpoint
+    void save_checkpoint() const {
+        std::string tmp = checkpoint_file + ".tmp";
+        std::ofstream output(tmp, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            std::cerr << "Error opening file: " << tmp << std::endl;
+            return;
+        }
+        gt_checkpoint_t header{CHECKPOINT_MAGIC, num_queries, vector_dim, k, base_rows, rows_done};
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& heap : heaps) {
+            int size = static_cast<int>(heap.size());
+            output.write(reinterpret_cast<const char*>(&size), sizeof(int));
+            output.write(reinterpret_cast<const char*>(heap.data()), size * sizeof(std::pair<float, int>));
+        }
+        output.close();
+        if (std::rename(tmp.c_str(), checkpoint_file.c_str()) != 0) {
+            std::cerr << "Error writing checkpoint: " << checkpoint_file << std::endl;
+        }
+    }
+
+    void scan(const char* chunk, long long first_row, int num_rows) {
+        const int tile = 256;   // rows kept hot in cache while every query visits them
+        // rows are raw fvecs records, so the floats start one int in and repeat every row_bytes
+        const float* rows = reinterpret_cast<const float*>(chunk + sizeof(int));
+        const size_t row_floats = row_bytes / sizeof(float);
+        int offsets[tile];
+        for (int r = 0; r < tile; ++r) offsets[r] = r;
+
+        #pragma omp parallel
+        {
+            float dists[tile];
+            for (int t = 0; t < num_rows; t += tile) {
+                int tile_end = std::min(num_rows, t + tile);
+
+                // static schedule gives each thread the same queries on every tile
+                #pragma omp for schedule(static) nowait
+                for (int q = 0; q < num_queries; ++q) {
+                    const float* query = queries + static_cast<size_t>(q) * vector_dim;
+                    auto& heap = heaps[q];
+                    compute_distances_batch(vector_dim, query, rows + t * row_floats, offsets, tile_end - t, dists, 8, row_floats);
+                    for (int r = t; r < tile_end; ++r) {
+                        std::pair<float, int> cand(dists[r - t], static_cast<int>(first_row + r));
+                        if (static_cast<int>(heap.size()) < k) {
+                            heap.push_back(cand);
+                            std::push_heap(heap.begin(), heap.end());
+                        } else if (cand < heap.front()) {
+                            std::pop_heap(heap.begin(), heap.end());
+                            heap.back() = cand;
+                            std::push_heap(heap.begin(), heap.end());
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<float, int>> sorted(int q) const {
+        std::vector<std::pair<float, int>> list = heaps[q];
+        std::sort(list.begin(), list.end());
+        return list;
+    }
+
+public:
+    GroundTruthGenerator(const std::string& base, const float* query_data, int num_query, int dim, int k_val,
+                         const std::string& checkpoint, int rows_per_chunk = 1 << 16, int chunks_per_checkpoint = 16) :
+    base_file(base), checkpoint_file(checkpoint), queries(query_data), num_queries(num_query), vector_dim(dim),
+    k(k_val), chunk_rows(rows_per_chunk), checkpoint_every(chunks_per_checkpoint), heaps(num_query) {
+        row_bytes = sizeof(int) + static_cast<size_t>(vector_dim) * sizeof(float);
+
+        struct stat st;
+        if (stat(base_file.c_str(), &st) != 0) {
+            std::cerr << "Error opening file: " << base_file << std::endl;
+            return;
+        }
+        // every fvecs row starts with its dim, the first one has to match the queries
+        int base_dim = 0;
+        std::ifstream input(base_file, std::ios::binary);
+        if (!input.read(reinterpret_cast<char*>(&base_dim), sizeof(int)) || base_dim != vector_dim) {
+            std::cerr << "Base vectors have dim " << base_dim << ", queries have dim " << vector_dim
+                      << ": " << base_file << std::endl;
+            return;
+        }
+        base_rows = st.st_size / static_cast<long long>(row_bytes);
+        base_ok = true;
+        for (auto& heap : heaps) heap.reserve(k);
+
+        if (!checkpoint_file.empty() && load_checkpoint()) {
+            std::cout << "Resuming ground truth from row " << rows_done << " of " << base_rows << std::endl;
+        }
+    }
+
+    // Scans at most max_chunks chunks (all if < 0). Returns true once the whole base is done.
+    bool run(int max_chunks = -1) {
+        if (!base_ok) return false;
+        double start = omp_get_wtime();
+        int fd = open(base_file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error opening file: " << base_file << std::endl;
+            return false;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        size_t buffer_bytes = static_cast<size_t>(chunk_rows) * row_bytes;
+        char* buffers[2];
+        buffers[0] = static_cast<char*>(aligned_alloc(4096, (buffer_bytes + 4095) / 4096 * 4096));
+        buffers[1] = static_cast<char*>(aligned_alloc(4096, (buffer_bytes + 4095) / 4096 * 4096));
+        if (!buffers[0] || !buffers[1]) throw std::bad_alloc();
+
+        auto rows_in = [&](long long first) {
+            return static_cast<int>(std::min<long long>(chunk_rows, base_rows - first));
+        };
+        // pread until the whole chunk is in, returns false on a short file or I/O error
+        auto read_chunk = [&](char* buffer, long long first) {
+            size_t want = static_cast<size_t>(rows_in(first)) * row_bytes;
+            size_t got = 0;
+            while (got < want) {
+                ssize_t n = pread(fd, buffer + got, want - got, static_cast<off_t>(first * row_bytes + got));
+                if (n <= 0) return false;
+                got += n;
+            }
+            return true;
+        };
+
+        bool ok = true;
+        int chunks = 0;
+        int current = 0;
+        if (rows_done < base_rows && max_chunks != 0) ok = read_chunk(buffers[current], rows_done);
+
+        while (ok && rows_done < base_rows && (max_chunks < 0 || chunks < max_chunks)) {
+            long long next_first = rows_done + rows_in(rows_done);
+            bool prefetch = next_first < base_rows && (max_chunks < 0 || chunks + 1 < max_chunks);
+            bool next_ok = true;
+            std::thread reader;
+            if (prefetch) {
+                reader = std::thread([&, next_first]() { next_ok = read_chunk(buffers[current ^ 1], next_first); });
+            }
+
+            scan(buffers[current], rows_done, rows_in(rows_done));
+            rows_done = next_first;
+            chunks++;
+
+            if (reader.joinable()) reader.join();
+            ok = next_ok;
+            current ^= 1;
+
+            if (!checkpoint_file.empty() && chunks % checkpoint_every == 0) save_checkpoint();
+        }
+
+        if (!ok) std::cerr << "Error reading file: " << base_file << std::endl;
+        if (!checkpoint_file.empty() && rows_done < base_rows) save_checkpoint();
+        if (!checkpoint_file.empty() && rows_done >= base_rows) std::remove(checkpoint_file.c_str());
+
+        free(buffers[0]);
+        free(buffers[1]);
+        close(fd);
+        runtime += (omp_get_wtime() - start) * 1000;
+        return ok && rows_done >= base_rows;
+    }
+
+    // k ids per query, nearest first, readable by GraphData<int> and Recall
+    bool write_ivecs(const std::string& file) const {
+        std::ofstream output(file, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            std::cerr << "Error opening file: " << file << std::endl;
+            return false;
+        }
+        for (int q = 0; q < num_queries; ++q) {
+            std::vector<std::pair<float, int>> list = sorted(q);
+            output.write(reinterpret_cast<const char*>(&k), sizeof(int));
+            for (int j = 0; j < k; ++j) {
+                int id = j < static_cast<int>(list.size()) ? list[j].second : -1;
+                output.write(reinterpret_cast<const char*>(&id), sizeof(int));
+            }
+        }
+        return static_cast<bool>(output);
+    }
+
+    // Matching squared L2 distances
+    bool write_fvecs(const std::string& file) const {
+        std::ofstream output(file, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            std::cerr << "Error opening file: " << file << std::endl;
+            return false;
+        }
+        for (int q = 0; q < num_queries; ++q) {
+            std::vector<std::pair<float, int>> list = sorted(q);
+            output.write(reinterpret_cast<const char*>(&k), sizeof(int));
+            for (int j = 0; j < k; ++j) {
+                float dist = j < static_cast<int>(list.size()) ? list[j].first : -1.0f;
+                output.write(reinterpret_cast<const char*>(&dist), sizeof(float));
+            }
+        }
+        return static_cast<bool>(output);
+    }
+
+    long long get_rows_done() const {
+        return rows_done;
+    }
+
+    long long get_base_rows() const {
+        return base_rows;
+    }
+
+    double get_runtime() const {
+        return runtime;
+    }
+};
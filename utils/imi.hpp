@@ -0,0 +1,200 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <queue>
+#include <tuple>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "distance.hpp"
+#include "kmeans.hpp"
+
+#include <omp.h>
+
+// Inverted multi-index: each vector is split into two halves and every half
+// gets its own KMeans codebook of K centroids. A cell is a pair (c1, c2), so
+// two small codebooks give K * K lists. Lists are stored CSR style, sorted by
+// cell. Both halves are scored by compute_distance_squared, so each half
+// width must be a multiple of 8.
+class InvertedMultiIndex {
+private:
+    int vector_dim;
+    int half_dim;
+    int K;
+    float* codebooks[2] = {nullptr, nullptr};   // [K][half_dim] per half
+
+    std::vector<int64_t> cell_begin;   // K * K + 1 offsets into list_ids
+    std::vector<int> list_ids;
+    int largest_cell = 0;
+    double build_time = 0;
+
+    // Per thread traversal state, reused across queries
+    struct traverse_scratch_t {
+        std::vector<std::pair<float, int>> order[2];   // half distance, centroid
+        std::vector<int> row_done;                     // cells visited in each row
+        std::vector<std::tuple<float, int, int>> heap;
+    };
+
+    static traverse_scratch_t& scratch() {
+        static thread_local traverse_scratch_t s;
+        return s;
+    }
+
+    int nearest(int half, const float* sub) const {
+        int best = 0;
+        float best_dist = std::numeric_limits<float>::max();
+        for (int c = 0; c < K; ++c) {
+            float dist = compute_distance_squared(half_dim, sub, codebooks[half] + static_cast<size_t>(c) * half_dim);
+            if (dist < best_dist) {
+                best_dist = dist;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+public:
+    InvertedMultiIndex(int dim, int k_per_half) : vector_dim(dim), half_dim(dim / 2), K(k_per_half) {
+        if (vector_dim <= 0 || vector_dim % 16 != 0 || K <= 0) {
+            std::cerr << "IMI needs dim to be a positive multiple of 16, got " << vector_dim << std::endl;
+            throw std::invalid_argument("InvertedMultiIndex: dim must be a positive multiple of 16");
+        }
+        for (int h = 0; h < 2; ++h) {
+            codebooks[h] = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(K) * half_dim * sizeof(float)));
+            if (!codebooks[h]) throw std::bad_alloc();
+        }
+    }
+
+    ~InvertedMultiIndex() {
+        free(codebooks[0]);
+        free(codebooks[1]);
+    }
+
+    InvertedMultiIndex(const InvertedMultiIndex&) = delete;
+    InvertedMultiIndex& operator=(const InvertedMultiIndex&) = delete;
+
+    // Trains both codebooks on at most sample_size rows, then files every row
+    // under its cell. Returns false if the sample has fewer rows than K.
+    bool build(const float* data, int num_points, int sample_size = 100000, int max_iterations = 25) {
+        auto start = std::chrono::high_resolution_clock::now();
+        int num_samples = std::min(num_points, sample_size);
+        if (num_samples < K) {
+            std::cerr << "IMI needs at least " << K << " training rows, got " << num_samples << std::endl;
+            return false;
+        }
+        std::vector<int> ids(num_points);
+        for (int i = 0; i < num_points; ++i) ids[i] = i;
+        std::mt19937 gen(42);
+        std::shuffle(ids.begin(), ids.end(), gen);
+
+        float* sub_data = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(num_samples) * half_dim * sizeof(float)));
+        if (!sub_data) throw std::bad_alloc();
+        for (int h = 0; h < 2; ++h) {
+            for (int i = 0; i < num_samples; ++i) {
+                std::memcpy(sub_data + static_cast<size_t>(i) * half_dim,
+                            data + static_cast<size_t>(ids[i]) * vector_dim + h * half_dim, half_dim * sizeof(float));
+            }
+            KMeans kmeans(K, half_dim, sub_data, num_samples);
+            kmeans.train(max_iterations);
+            std::memcpy(codebooks[h], kmeans.get_clusters(), static_cast<size_t>(K) * half_dim * sizeof(float));
+        }
+        free(sub_data);
+
+        std::vector<int> cells(num_points);
+        #pragma omp parallel for
+        for (int i = 0; i < num_points; ++i) {
+            const float* point = data + static_cast<size_t>(i) * vector_dim;
+            cells[i] = nearest(0, point) * K + nearest(1, point + half_dim);
+        }
+
+        size_t num_cells = static_cast<size_t>(K) * K;
+        cell_begin.assign(num_cells + 1, 0);
+        for (int cell : cells) cell_begin[cell + 1]++;
+        for (size_t c = 0; c < num_cells; ++c) {
+            largest_cell = std::max(largest_cell, static_cast<int>(cell_begin[c + 1]));
+            cell_begin[c + 1] += cell_begin[c];
+        }
+        list_ids.resize(num_points);
+        std::vector<int64_t> fill(cell_begin.begin(), cell_begin.end() - 1);
+        for (int i = 0; i < num_points; ++i) list_ids[fill[cells[i]]++] = i;
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        build_time = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        return true;
+    }
+
+    // Multi-sequence traversal: cells are visited in increasing d1 + d2 order,
+    // where d1, d2 are the query's distances to the two half centroids. The
+    // visited cells form a staircase, so a cell (i, j) enters the heap only
+    // once both (i - 1, j) and (i, j - 1) are done. Ids of the visited cells
+    // go to out until at least max_candidates are collected; out needs room
+    // for max_candidates + get_largest_cell(). Returns the number written.
+    int candidates(const float* query, int max_candidates, int* out) const {
+        traverse_scratch_t& s = scratch();
+        for (int h = 0; h < 2; ++h) {
+            s.order[h].resize(K);
+            for (int c = 0; c < K; ++c) {
+                float dist = compute_distance_squared(half_dim, query + h * half_dim, codebooks[h] + static_cast<size_t>(c) * half_dim);
+                s.order[h][c] = std::make_pair(dist, c);
+            }
+            std::sort(s.order[h].begin(), s.order[h].end());
+        }
+        s.row_done.assign(K, 0);
+        s.heap.clear();
+        s.heap.reserve(K);   // at most one pending cell per row
+
+        typedef std::tuple<float, int, int> item_t;
+        auto greater = [](const item_t& a, const item_t& b) { return std::get<0>(a) > std::get<0>(b); };
+        s.heap.push_back(item_t(s.order[0][0].first + s.order[1][0].first, 0, 0));
+
+        int count = 0;
+        while (!s.heap.empty() && count < max_candidates) {
+            std::pop_heap(s.heap.begin(), s.heap.end(), greater);
+            int i = std::get<1>(s.heap.back());
+            int j = std::get<2>(s.heap.back());
+            s.heap.pop_back();
+            s.row_done[i] = j + 1;
+
+            size_t cell = static_cast<size_t>(s.order[0][i].second) * K + s.order[1][j].second;
+            for (int64_t p = cell_begin[cell]; p < cell_begin[cell + 1]; ++p) out[count++] = list_ids[p];
+
+            // right neighbour, once the cell above it is done
+            if (j + 1 < K && (i == 0 || s.row_done[i - 1] > j + 1)) {
+                s.heap.push_back(item_t(s.order[0][i].first + s.order[1][j + 1].first, i, j + 1));
+                std::push_heap(s.heap.begin(), s.heap.end(), greater);
+            }
+            // lower neighbour, once the cell left of it is done
+            if (i + 1 < K && s.row_done[i + 1] == j) {
+                s.heap.push_back(item_t(s.order[0][i + 1].first + s.order[1][j].first, i + 1, j));
+                std::push_heap(s.heap.begin(), s.heap.end(), greater);
+            }
+        }
+        return count;
+    }
+
+    size_t get_num_cells() const {
+        return static_cast<size_t>(K) * K;
+    }
+
+    int get_num_nonempty() const {
+        int count = 0;
+        for (size_t c = 0; c + 1 < cell_begin.size(); ++c) count += cell_begin[c + 1] > cell_begin[c] ? 1 : 0;
+        return count;
+    }
+
+    int get_largest_cell() const {
+        return largest_cell;
+    }
+
+    double get_build_time() const {
+        return build_time;
+    }
+};
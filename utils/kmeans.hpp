@@ -53,7 +53,24 @@ public:
         }
     }
 
+    // Seeds the centroids with distinct data points instead of random values,
+    // so no centroid starts outside the data's range and stays empty.
+    void initialize_from_data() {
+        std::mt19937 gen(42);
+        std::vector<int> ids(num_points);
+        for (int i = 0; i < num_points; ++i) ids[i] = i;
+        for (int i = 0; i < num_clusters; ++i) {
+            if (i < num_points) {
+                std::uniform_int_distribution<> distr(i, num_points - 1);
+                std::swap(ids[i], ids[distr(gen)]);
+            }
+            std::memcpy(clusters + i * base_dim, base_data + static_cast<size_t>(ids[i % num_points]) * base_dim,
+                        base_dim * sizeof(float));
+        }
+    }
+
     void assign_clusters() {
+        #pragma omp parallel for
         for (int i = 0; i < num_points; ++i) {
             float* point = base_data + i * base_dim;
             int nearest_cluster = -1;
@@ -114,6 +131,16 @@ public:
         }
     }
 
+    // Data-seeded Lloyd iterations, run one after another. Used for codebooks
+    // (e.g. PQ sub-spaces) where every centroid has to end up populated.
+    void train(int max_iterations) {
+        initialize_from_data();
+        for (int iter = 0; iter < max_iterations; ++iter) {
+            assign_clusters();
+            update_clusters();
+        }
+    }
+
     float* get_clusters() const {
         return clusters;
     }
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <new>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// mbind policies (see <numaif.h>), spelled out so we don't need libnuma
+#ifndef MPOL_BIND
+#define MPOL_PREFERRED   1
+#define MPOL_BIND        2
+#define MPOL_INTERLEAVE  3
+#endif
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+enum NumaMode {
+    NUMA_OFF,           // single aligned_alloc, first touch by the loading thread
+    NUMA_INTERLEAVE,    // pages spread round robin over all nodes
+    NUMA_SHARD          // contiguous row ranges, one per node
+};
+
+// Nodes and their cpus, read from sysfs. Falls back to a single node
+// holding every online cpu when sysfs has no node directories.
+class NumaTopology {
+private:
+    std::vector<int> node_ids;
+    std::vector<std::vector<int>> node_cpus;
+
+    static std::vector<int> parse_cpulist(const std::string& list) {
+        // format: "0-3,8-11"
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int lo = std::stoi(range.substr(0, dash));
+            int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+            for (int c = lo; c <= hi; ++c) cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+public:
+    NumaTopology() {
+        // node ids may have holes, and memory-only nodes have no cpus
+        for (int node = 0; node < 64; ++node) {
+            std::ifstream input("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!input) continue;
+            std::string list;
+            std::getline(input, list);
+            std::vector<int> cpus = parse_cpulist(list);
+            if (cpus.empty()) continue;
+            node_ids.push_back(node);
+            node_cpus.push_back(cpus);
+        }
+
+        if (node_cpus.empty()) {
+            int num_cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+            node_ids.push_back(0);
+            node_cpus.emplace_back();
+            for (int c = 0; c < num_cpus; ++c) node_cpus[0].push_back(c);
+        }
+    }
+
+    int get_num_nodes() const {
+        return static_cast<int>(node_cpus.size());
+    }
+
+    // bit mask for mbind of the n-th node
+    unsigned long get_mask(int n) const {
+        return 1UL << node_ids[n];
+    }
+
+    unsigned long get_all_mask() const {
+        unsigned long mask = 0;
+        for (int id : node_ids) mask |= 1UL << id;
+        return mask;
+    }
+
+    const std::vector<int>& get_cpus(int n) const {
+        return node_cpus[n];
+    }
+};
+
+// Pins the calling thread to one cpu and restores its old mask on scope
+// exit, so OpenMP pool threads are free again for non-NUMA searches.
+class ThreadPin {
+private:
+    cpu_set_t saved;
+    bool pinned = false;
+
+public:
+    ThreadPin(int cpu) {
+        if (sched_getaffinity(0, sizeof(saved), &saved) != 0) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+    ~ThreadPin() {
+        if (pinned) sched_setaffinity(0, sizeof(saved), &saved);
+    }
+};
+
+// Set the placement policy of [addr, addr+bytes) before it is first touched.
+// page is the page size backing the range: hugetlb mappings can only be
+// bound in whole huge pages, so the range is widened to page boundaries
+// (a page shared by two ranges goes to the last caller). Failure (e.g.
+// kernel without NUMA) only costs locality, so it is reported, not fatal.
+inline bool numa_bind(void* addr, size_t bytes, int policy, unsigned long nodemask, size_t page = 0) {
+    if (page == 0) page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(addr) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + bytes + page - 1) & ~(page - 1);
+    long ret = syscall(SYS_mbind, begin, end - begin, policy, &nodemask, sizeof(nodemask) * 8, 0);
+    if (ret != 0) {
+        std::cerr << "mbind failed (" << std::strerror(errno) << "), pages keep the default placement" << std::endl;
+    }
+    return ret == 0;
+}
+
+inline size_t numa_round_size(size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+// Huge-page backed anonymous mapping. Tries explicit MAP_HUGETLB pages first
+// and falls back to normal pages with transparent huge pages requested.
+// page, if given, receives the page size to pass to numa_bind.
+inline void* numa_alloc(size_t bytes, size_t* page = nullptr) {
+    size_t size = numa_round_size(bytes);
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (page) *page = HUGE_PAGE_SIZE;
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) throw std::bad_alloc();
+        madvise(ptr, size, MADV_HUGEPAGE);
+        if (page) *page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    return ptr;
+}
+
+inline void numa_free(void* ptr, size_t bytes) {
+    if (ptr) munmap(ptr, numa_round_size(bytes));
+}
+
+// Row ranges of a base set sharded over the nodes: shard n owns rows
+// [row_begin[n], row_begin[n+1]) and its pages live on node n.
+struct NumaShards {
+    NumaTopology topo;
+    std::vector<int> row_begin;
+
+    NumaShards() {}
+
+    NumaShards(int num_rows) {
+        int num_nodes = topo.get_num_nodes();
+        row_begin.resize(num_nodes + 1);
+        for (int n = 0; n <= num_nodes; ++n) {
+            row_begin[n] = static_cast<int>(static_cast<long>(num_rows) * n / num_nodes);
+        }
+    }
+
+    int get_num_shards() const {
+        return static_cast<int>(row_begin.size()) - 1;
+    }
+
+    int shard_of(int row) const {
+        int n = 0;
+        while (row >= row_begin[n + 1]) ++n;
+        return n;
+    }
+};
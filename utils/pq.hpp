@@ -0,0 +1,155 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <stdint.h>
+
+#include "distance.hpp"
+#include "kmeans.hpp"
+
+#include <omp.h>
+
+#define PQ_CENTROIDS 256
+
+// Product quantizer: splits a vector into num_subspaces chunks and stores
+// each chunk as the id of its nearest centroid in a 256 entry codebook, so a
+// vector compresses to num_subspaces bytes. Each sub-space is trained with
+// KMeans, whose kernel needs sub-space widths that are a multiple of 8.
+class ProductQuantizer {
+private:
+    int vector_dim;
+    int num_subspaces;
+    int sub_dim;
+    float* codebooks = nullptr;   // [subspace][centroid][sub_dim]
+
+public:
+    // Whether dim splits into m sub-spaces the KMeans kernel can handle
+    static bool supports(int dim, int m) {
+        return dim > 0 && m > 0 && dim % m == 0 && (dim / m) % 8 == 0;
+    }
+
+    ProductQuantizer(int dim, int m) : vector_dim(dim), num_subspaces(m) {
+        sub_dim = num_subspaces > 0 ? vector_dim / num_subspaces : 0;
+        if (!supports(vector_dim, num_subspaces)) {
+            std::cerr << "PQ needs dim / num_subspaces to be a multiple of 8, got "
+                      << vector_dim << " / " << num_subspaces << std::endl;
+        }
+        codebooks = static_cast<float*>(aligned_alloc(32, num_subspaces * PQ_CENTROIDS * sub_dim * sizeof(float)));
+        if (!codebooks) throw std::bad_alloc();
+    }
+
+    ~ProductQuantizer() {
+        free(codebooks);
+    }
+
+    ProductQuantizer(const ProductQuantizer&) = delete;
+    ProductQuantizer& operator=(const ProductQuantizer&) = delete;
+
+    // Trains on at most sample_size rows picked at random
+    void train(const float* data, int num_points, int sample_size, int max_iterations = 25) {
+        int num_samples = std::min(num_points, sample_size);
+        std::vector<int> ids(num_points);
+        for (int i = 0; i < num_points; ++i) ids[i] = i;
+        std::mt19937 gen(42);
+        std::shuffle(ids.begin(), ids.end(), gen);
+
+        float* sub_data = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(num_samples) * sub_dim * sizeof(float)));
+        if (!sub_data) throw std::bad_alloc();
+
+        for (int m = 0; m < num_subspaces; ++m) {
+            for (int i = 0; i < num_samples; ++i) {
+                std::memcpy(sub_data + static_cast<size_t>(i) * sub_dim,
+                            data + static_cast<size_t>(ids[i]) * vector_dim + m * sub_dim, sub_dim * sizeof(float));
+            }
+            KMeans kmeans(PQ_CENTROIDS, sub_dim, sub_data, num_samples);
+            kmeans.train(max_iterations);
+            std::memcpy(codebooks + m * PQ_CENTROIDS * sub_dim, kmeans.get_clusters(),
+                        PQ_CENTROIDS * sub_dim * sizeof(float));
+        }
+
+        free(sub_data);
+    }
+
+    // codes: num_points * num_subspaces bytes
+    void encode(const float* data, int num_points, uint8_t* codes) const {
+        #pragma omp parallel for
+        for (int i = 0; i < num_points; ++i) {
+            const float* vec = data + static_cast<size_t>(i) * vector_dim;
+            for (int m = 0; m < num_subspaces; ++m) {
+                const float* sub = vec + m * sub_dim;
+                const float* book = codebooks + m * PQ_CENTROIDS * sub_dim;
+                int best = 0;
+                float best_dist = FLT_MAX;
+                for (int c = 0; c < PQ_CENTROIDS; ++c) {
+                    float dist = 0;
+                    for (int j = 0; j < sub_dim; ++j) {
+                        float diff = sub[j] - book[c * sub_dim + j];
+                        dist += diff * diff;
+                    }
+                    if (dist < best_dist) {
+                        best_dist = dist;
+                        best = c;
+                    }
+                }
+                codes[static_cast<size_t>(i) * num_subspaces + m] = static_cast<uint8_t>(best);
+            }
+        }
+    }
+
+    // Reconstruction from codes, num_points * dim floats
+    void decode(const uint8_t* codes, int num_points, float* data) const {
+        #pragma omp parallel for
+        for (int i = 0; i < num_points; ++i) {
+            for (int m = 0; m < num_subspaces; ++m) {
+                uint8_t c = codes[static_cast<size_t>(i) * num_subspaces + m];
+                std::memcpy(data + static_cast<size_t>(i) * vector_dim + m * sub_dim,
+                            codebooks + (m * PQ_CENTROIDS + c) * sub_dim, sub_dim * sizeof(float));
+            }
+        }
+    }
+
+    // Per query lookup table of squared distances, num_subspaces * 256 floats
+    void compute_table(const float* query, float* table) const {
+        for (int m = 0; m < num_subspaces; ++m) {
+            const float* sub = query + m * sub_dim;
+            const float* book = codebooks + m * PQ_CENTROIDS * sub_dim;
+            for (int c = 0; c < PQ_CENTROIDS; ++c) {
+                float dist = 0;
+                for (int j = 0; j < sub_dim; ++j) {
+                    float diff = sub[j] - book[c * sub_dim + j];
+                    dist += diff * diff;
+                }
+                table[m * PQ_CENTROIDS + c] = dist;
+            }
+        }
+    }
+
+    float table_distance(const float* table, const uint8_t* code) const {
+        float dist = 0;
+        for (int m = 0; m < num_subspaces; ++m) {
+            dist += table[m * PQ_CENTROIDS + code[m]];
+        }
+        return dist;
+    }
+
+    int get_num_subspaces() const {
+        return num_subspaces;
+    }
+
+    size_t codebook_size() const {
+        return static_cast<size_t>(num_subspaces) * PQ_CENTROIDS * sub_dim;
+    }
+
+    float* get_codebooks() {
+        return codebooks;
+    }
+
+    const float* get_codebooks() const {
+        return codebooks;
+    }
+};
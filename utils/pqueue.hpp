@@ -1,10 +1,63 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <functional>
 #include <stdint.h>
 #include <string.h>
 #include "common.hpp"
 
+// k-way merge of sorted runs, e.g. per-shard top-k lists. Keeps the first k
+// unique vids in ascending distance order and returns how many were written.
+// Run r holds run_lens[r] entries; a negative vid ends a run early (padding
+// of short result lists).
+template <typename T>
+int kway_merge(const std::vector<const T*> &vids, const std::vector<const float*> &dists,
+               const int* run_lens, int k, T* out_vids, float* out_dists) {
+  typedef std::pair<float, int> head_t; // (distance, run)
+  // per thread scratch, so merging on the search path doesn't allocate once warm
+  static thread_local std::vector<head_t> heap;
+  static thread_local std::vector<int> pos;
+  heap.clear();
+  pos.assign(vids.size(), 0);
+  for (size_t r = 0; r < vids.size(); r++) {
+    if (run_lens[r] > 0 && vids[r][0] >= 0) heap.push_back(head_t(dists[r][0], r));
+  }
+  std::make_heap(heap.begin(), heap.end(), std::greater<head_t>());
+
+  int count = 0;
+  while (count < k && !heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<head_t>());
+    int r = heap.back().second;
+    heap.pop_back();
+    T vid = vids[r][pos[r]];
+    // runs are disjoint in practice, but equal-distance duplicates are adjacent
+    bool dup = false;
+    for (int c = count - 1; c >= 0 && out_dists[c] == dists[r][pos[r]]; c--) {
+      if (out_vids[c] == vid) { dup = true; break; }
+    }
+    if (!dup) {
+      out_vids[count] = vid;
+      out_dists[count] = dists[r][pos[r]];
+      count++;
+    }
+    if (++pos[r] < run_lens[r] && vids[r][pos[r]] >= 0) {
+      heap.push_back(head_t(dists[r][pos[r]], r));
+      std::push_heap(heap.begin(), heap.end(), std::greater<head_t>());
+    }
+  }
+  return count;
+}
+
+// Same, with every run run_len long
+template <typename T>
+int kway_merge(const std::vector<const T*> &vids, const std::vector<const float*> &dists,
+               int run_len, int k, T* out_vids, float* out_dists) {
+  static thread_local std::vector<int> run_lens;
+  run_lens.assign(vids.size(), run_len);
+  return kway_merge(vids, dists, run_lens.data(), k, out_vids, out_dists);
+}
+
 template <typename T>
 class pqueue_t {
 private:
@@ -19,6 +72,7 @@ private:
   std::vector<uint8_t> expanded2;
 
 public:
+  pqueue_t() : queue_size(0), queue_capacity(0), next_idx(0) {}
   pqueue_t(int L) {
     next_idx = 0;
     queue_size = 0;
@@ -49,6 +103,21 @@ public:
   int size() { return queue_size; }
   void clear() { queue_size = 0; next_idx = 0; }
 
+  // Empties the queue and sets its capacity to L, keeping the buffers when
+  // they are already large enough (only ever grows)
+  void reset(int L) {
+    if (vid_queue.size() < static_cast<size_t>(2*L)) {
+      vid_queue.resize(2*L);
+      distances.resize(2*L);
+      expanded.resize(2*L);
+      vid_queue2.resize(2*L);
+      distances2.resize(2*L);
+      expanded2.resize(2*L);
+    }
+    queue_capacity = L;
+    clear();
+  }
+
   void set_expanded(int idx) { expanded[idx] = 1; }
   void set_unexpanded(int idx) { expanded[idx] = 0; }
 
@@ -73,25 +142,47 @@ public:
     return true;
   }
 
+  // Merges the local queues back with one k-way merge over this queue and
+  // every lqs. A vid stays expanded only if every copy of it was, so work a
+  // local queue has not done yet is redone. Returns the new next_idx.
   int merge_queues(std::vector<pqueue_t> &lqs) {
-    // linear insertion
-    // TODO: do 'merge' instead to improve performance
+    static thread_local std::vector<const T*> run_vids;
+    static thread_local std::vector<const float*> run_dists;
+    static thread_local std::vector<const uint8_t*> run_flags;
+    static thread_local std::vector<int> run_lens, pos;
+    run_vids.assign(1, vid_queue.data());
+    run_dists.assign(1, distances.data());
+    run_flags.assign(1, expanded.data());
+    run_lens.assign(1, queue_size);
     for (size_t i = 0; i < lqs.size(); i++) {
-      for (int j = 0; j < lqs[i].size(); j++) {
-        auto loc = push(lqs[i][j], lqs[i].get_dist(j));
-        if (loc == -2) { // Duplicate
-          if (!lqs[i].is_expanded(j) && is_expanded(loc)) {
-            set_unexpanded(loc);
-            if (loc < next_idx) next_idx = loc;
-          }
-        } else if (loc >= 0) {
-          if (lqs[i].is_expanded(j)) {
-            set_expanded(loc);
-            if (loc < next_idx) next_idx++;
-          } else if (loc < next_idx) next_idx = loc;
+      run_vids.push_back(lqs[i].vid_queue.data());
+      run_dists.push_back(lqs[i].distances.data());
+      run_flags.push_back(lqs[i].expanded.data());
+      run_lens.push_back(lqs[i].queue_size);
+    }
+
+    int count = kway_merge(run_vids, run_dists, run_lens.data(), queue_capacity, vid_queue2.data(), distances2.data());
+
+    // every run is sorted like the output, so one cursor per run finds the
+    // copies of each merged vid among the entries at its distance
+    pos.assign(run_vids.size(), 0);
+    for (int c = 0; c < count; c++) {
+      uint8_t flag = 1;
+      for (size_t r = 0; r < run_vids.size(); r++) {
+        while (pos[r] < run_lens[r] && run_dists[r][pos[r]] < distances2[c]) pos[r]++;
+        for (int p = pos[r]; p < run_lens[r] && run_dists[r][p] == distances2[c]; p++) {
+          if (run_vids[r][p] == vid_queue2[c]) flag &= run_flags[r][p];
         }
       }
+      expanded2[c] = flag;
     }
+
+    swap(vid_queue, vid_queue2);
+    swap(distances, distances2);
+    swap(expanded, expanded2);
+    queue_size = count;
+    next_idx = 0;
+    while (next_idx < queue_size && expanded[next_idx]) next_idx++;
     return next_idx;
   }
 
@@ -166,7 +257,9 @@ public:
     }
 
     int i = 0,j = 0,k = 0;
-    while ((i < queue_size) && (j < ins.size())) {
+    int num_ins = static_cast<int>(ins.size());
+    // entries past the capacity would be dropped anyway, so the merge stops there
+    while ((i < queue_size) && (j < num_ins) && (k < queue_capacity)) {
       if (vid_queue[i] == ins[j].second) j++;
       else if (distances[i] < ins[j].first) {
         vid_queue2[k] = vid_queue[i];
@@ -181,13 +274,13 @@ public:
         j++,k++;
       }
     }
-    while (i < queue_size) {
+    while ((i < queue_size) && (k < queue_capacity)) {
       vid_queue2[k] = vid_queue[i];
       distances2[k] = distances[i];
       expanded2[k] = expanded[i];
       i++,k++;
     }
-    while (j < ins.size()) {
+    while ((j < num_ins) && (k < queue_capacity)) {
       vid_queue2[k] = ins[j].second;
       distances2[k] = ins[j].first;
       expanded2[k] = 0;
@@ -213,14 +306,38 @@ public:
     next_idx = 0;
   }
 
-  T* fetch_unexpanded_nodes(int P) {
-    T* nodes = new T[P];
+  // Bulk insert of n scored candidates: the ones that can't enter a full
+  // queue are dropped, the rest are sorted into ins and merged in one pass
+  void batch_push(const T* vids, const float* dists, int n, std::vector<std::pair<float,T> > &ins) {
+    ins.clear();
+    float bound = queue_size < queue_capacity ? FLT_MAX : distances[queue_size-1];
+    for (int c = 0; c < n; c++) {
+      if (dists[c] < bound) ins.push_back(std::make_pair(dists[c], vids[c]));
+    }
+    std::sort(ins.begin(), ins.end());
+    batch_push(ins);
+  }
+
+  // Takes up to P unexpanded vids from the front of the queue, marks them
+  // expanded and moves next_idx past them. Returns how many were written.
+  int pop_unexpanded(int P, T* nodes) {
+    int count = 0;
+    for (int i = next_idx; i < queue_size && count < P; i++) {
+      if (expanded[i]) continue;
+      expanded[i] = 1;
+      nodes[count++] = vid_queue[i];
+    }
+    while (next_idx < queue_size && expanded[next_idx]) next_idx++;
+    return count;
+  }
+
+  // Copies up to P unexpanded vids into nodes without marking them
+  int fetch_unexpanded_nodes(int P, T* nodes) const {
     int count = 0;
-    for (int i = 0; i < queue_size; i++) {
-      if (expanded[i]) nodes[count++] = i;
-      if (count == P) break;
+    for (int i = next_idx; i < queue_size && count < P; i++) {
+      if (!expanded[i]) nodes[count++] = vid_queue[i];
     }
-    return nodes;
+    return count;
   }
 };
 
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <atomic>
+#include <mutex>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "distance.hpp"
+
+// Search engines a cached result can come from, part of every cache key
+enum CacheEngine {
+    CACHE_BRUTE = 1,
+    CACHE_IVF = 2
+};
+
+// Bounded cache of top-k results in front of the search entry points.
+//  - exact repeats: hash of the query quantized to quant_step
+//  - near duplicates: random hyperplane LSH bucket, then a squared L2 check
+//    against the cached query (near_threshold)
+// Both keys also hash the search configuration (config_key): the engine, a
+// fingerprint of the index it searched and nprobe / nlist, so results of
+// another engine, index or parameter set never answer each other. A hit is
+// confirmed against the stored query and config, never by hash alone. Entries live
+// in shards chosen by exact key, each with its own lock and a CLOCK eviction
+// hand, so concurrent queries rarely contend. The LSH buckets are kept in
+// their own shards and only point at entries. invalidate() bumps an epoch
+// that lazily retires every entry after an index update.
+class QueryCache {
+private:
+    struct entry_t {
+        uint64_t exact_key;
+        uint64_t lsh_key;      // LSH bucket mixed with the config
+        uint64_t config;
+        uint64_t epoch;
+        uint64_t cost_ns;      // search time this entry saves on a hit
+        bool used;
+        bool referenced;
+    };
+
+    struct shard_t {
+        std::mutex lock;
+        std::vector<entry_t> entries;
+        std::vector<float> queries;   // [slot][dim]
+        std::vector<int> results;     // [slot][k]
+        std::unordered_map<uint64_t, int> exact_index;
+        int hand = 0;
+    };
+
+    struct lsh_ref_t {
+        int shard;
+        int slot;
+    };
+
+    // Taken after a shard lock, never before one
+    struct lsh_shard_t {
+        std::mutex lock;
+        std::unordered_multimap<uint64_t, lsh_ref_t> index;
+    };
+
+    // Near-match candidates checked per lookup
+    static const int MAX_PROBES = 8;
+
+    int vector_dim;
+    int k;
+    int slots_per_shard;
+    float quant_step;
+    float near_threshold;
+    int lsh_bits;
+
+    std::vector<float> hyperplanes;   // [lsh_bits][dim]
+    std::vector<float> center;
+    std::vector<shard_t> shards;
+    std::vector<lsh_shard_t> lsh_shards;
+    std::atomic<uint64_t> epoch{0};
+
+    std::atomic<uint64_t> exact_hits{0};
+    std::atomic<uint64_t> near_hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> saved_ns{0};
+
+    int64_t quantize(float x) const {
+        return static_cast<int64_t>(std::floor(x / quant_step + 0.5f));
+    }
+
+    // Whether two queries fall in the same quantization cell, i.e. are exact repeats
+    bool same_cell(const float* a, const float* b) const {
+        for (int j = 0; j < vector_dim; ++j) {
+            if (quantize(a[j]) != quantize(b[j])) return false;
+        }
+        return true;
+    }
+
+    uint64_t exact_hash(const float* query) const {
+        // FNV-1a over the quantized coordinates
+        uint64_t hash = 14695981039346656037ULL;
+        for (int j = 0; j < vector_dim; ++j) {
+            int64_t q = quantize(query[j]);
+            for (int b = 0; b < 8; ++b) {
+                hash ^= static_cast<uint64_t>(q >> (8 * b)) & 0xff;
+                hash *= 1099511628211ULL;
+            }
+        }
+        return hash;
+    }
+
+    uint64_t lsh_hash(const float* query) const {
+        uint64_t key = 0;
+        for (int b = 0; b < lsh_bits; ++b) {
+            const float* plane = &hyperplanes[static_cast<size_t>(b) * vector_dim];
+            float dot = 0;
+            for (int j = 0; j < vector_dim; ++j) dot += (query[j] - center[j]) * plane[j];
+            if (dot > 0) key |= 1ULL << b;
+        }
+        return key;
+    }
+
+    float squared_distance(const float* a, const float* b) const {
+        float dist = 0;
+        for (int j = 0; j < vector_dim; ++j) {
+            float diff = a[j] - b[j];
+            dist += diff * diff;
+        }
+        return dist;
+    }
+
+    shard_t& shard_of(uint64_t exact_key) {
+        return shards[exact_key % shards.size()];
+    }
+
+    lsh_shard_t& lsh_shard_of(uint64_t lsh_key) {
+        return lsh_shards[lsh_key % lsh_shards.size()];
+    }
+
+    // Caller holds shard.lock
+    void remove(shard_t& shard, int slot) {
+        entry_t& e = shard.entries[slot];
+        if (!e.used) return;
+        auto exact = shard.exact_index.find(e.exact_key);
+        if (exact != shard.exact_index.end() && exact->second == slot) shard.exact_index.erase(exact);
+        if (near_threshold > 0) {
+            int shard_id = static_cast<int>(&shard - shards.data());
+            lsh_shard_t& lsh = lsh_shard_of(e.lsh_key);
+            std::lock_guard<std::mutex> guard(lsh.lock);
+            auto range = lsh.index.equal_range(e.lsh_key);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second.shard == shard_id && it->second.slot == slot) {
+                    lsh.index.erase(it);
+                    break;
+                }
+            }
+        }
+        e.used = false;
+    }
+
+    // Copies the cached top-k of the first live entry within near_threshold
+    bool lookup_near(const float* query, uint64_t config, uint64_t lsh_key, uint64_t current, int* results) {
+        lsh_ref_t refs[MAX_PROBES];
+        int num_refs = 0;
+        {
+            lsh_shard_t& lsh = lsh_shard_of(lsh_key);
+            std::lock_guard<std::mutex> guard(lsh.lock);
+            auto range = lsh.index.equal_range(lsh_key);
+            for (auto it = range.first; it != range.second && num_refs < MAX_PROBES; ++it) refs[num_refs++] = it->second;
+        }
+
+        // the slot may have been reused since, so the entry itself is checked again
+        for (int r = 0; r < num_refs; ++r) {
+            shard_t& shard = shards[refs[r].shard];
+            std::lock_guard<std::mutex> guard(shard.lock);
+            entry_t& e = shard.entries[refs[r].slot];
+            if (!e.used || e.lsh_key != lsh_key || e.config != config || e.epoch != current) continue;
+            const float* cached = &shard.queries[static_cast<size_t>(refs[r].slot) * vector_dim];
+            if (squared_distance(query, cached) > near_threshold) continue;
+            e.referenced = true;
+            memcpy(results, &shard.results[static_cast<size_t>(refs[r].slot) * k], k * sizeof(int));
+            near_hits++;
+            saved_ns += e.cost_ns;
+            return true;
+        }
+        return false;
+    }
+
+    // CLOCK: sweep clearing reference bits, take the first unreferenced or stale slot
+    int evict(shard_t& shard) {
+        uint64_t current = epoch.load(std::memory_order_relaxed);
+        while (true) {
+            int slot = shard.hand;
+            shard.hand = (shard.hand + 1) % slots_per_shard;
+            entry_t& e = shard.entries[slot];
+            if (!e.used || e.epoch != current || !e.referenced) {
+                remove(shard, slot);
+                return slot;
+            }
+            e.referenced = false;
+        }
+    }
+
+public:
+    QueryCache(int dim, int k_val, int capacity, float step = 1.0f, float near_dist = 0.0f,
+               int num_bits = 12, int num_shards = 16) :
+    vector_dim(dim), k(k_val), quant_step(step), near_threshold(near_dist), lsh_bits(std::min(num_bits, 64)),
+    hyperplanes(static_cast<size_t>(lsh_bits) * dim), center(dim, 0.0f), shards(num_shards), lsh_shards(num_shards) {
+        slots_per_shard = std::max(1, capacity / num_shards);
+
+        std::mt19937 gen(42);
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        for (float& x : hyperplanes) x = normal(gen);
+
+        for (shard_t& shard : shards) {
+            shard.entries.assign(slots_per_shard, entry_t{0, 0, 0, 0, 0, false, false});
+            shard.queries.resize(static_cast<size_t>(slots_per_shard) * vector_dim);
+            shard.results.resize(static_cast<size_t>(slots_per_shard) * k);
+        }
+    }
+
+    // Centres the LSH hyperplanes on the data, needed for all-positive
+    // features such as SIFT where every query would land on the same side
+    void train(const float* data, int num_points) {
+        std::vector<double> sum(vector_dim, 0.0);
+        for (int i = 0; i < num_points; ++i) {
+            for (int j = 0; j < vector_dim; ++j) sum[j] += data[static_cast<size_t>(i) * vector_dim + j];
+        }
+        for (int j = 0; j < vector_dim; ++j) center[j] = num_points > 0 ? static_cast<float>(sum[j] / num_points) : 0.0f;
+    }
+
+    // Folds value into hash, for building config and index keys
+    static uint64_t mix(uint64_t hash, uint64_t value) {
+        return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+    }
+
+    // Identifies a block of vectors without reading all of it: the row count
+    // and up to max_rows rows spread over the block, hashed bit for bit
+    static uint64_t fingerprint(const float* data, size_t num_rows, int dim, size_t max_rows = 64) {
+        uint64_t key = mix(0, num_rows);
+        size_t step = std::max<size_t>(1, num_rows / std::max<size_t>(1, max_rows));
+        for (size_t i = 0; i < num_rows; i += step) {
+            const float* row = data + i * dim;
+            for (int j = 0; j < dim; ++j) {
+                uint32_t bits;
+                memcpy(&bits, &row[j], sizeof(bits));
+                key = mix(key, bits);
+            }
+        }
+        return key;
+    }
+
+    // Key of one search configuration: the engine, the index it runs on
+    // (e.g. a fingerprint) and its parameters (nlist / nprobe for IVF).
+    // Lookups only hit entries of the same config.
+    static uint64_t config_key(CacheEngine engine, uint64_t index_key, int num_lists = 0, int num_probes = 0) {
+        uint64_t key = mix(0, static_cast<uint64_t>(engine));
+        key = mix(key, index_key);
+        key = mix(key, static_cast<uint64_t>(num_lists));
+        return mix(key, static_cast<uint64_t>(num_probes));
+    }
+
+    // Copies the cached top-k into results on a hit
+    bool lookup(const float* query, uint64_t config, int* results) {
+        uint64_t exact_key = mix(exact_hash(query), config);
+        uint64_t current = epoch.load(std::memory_order_acquire);
+        {
+            shard_t& shard = shard_of(exact_key);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            auto it = shard.exact_index.find(exact_key);
+            // a matching hash is only a candidate, the stored query has to be in the same cell
+            if (it != shard.exact_index.end() && shard.entries[it->second].epoch == current &&
+                shard.entries[it->second].config == config &&
+                same_cell(query, &shard.queries[static_cast<size_t>(it->second) * vector_dim])) {
+                entry_t& e = shard.entries[it->second];
+                e.referenced = true;
+                memcpy(results, &shard.results[static_cast<size_t>(it->second) * k], k * sizeof(int));
+                exact_hits++;
+                saved_ns += e.cost_ns;
+                return true;
+            }
+        }
+
+        if (near_threshold > 0 && lookup_near(query, config, mix(lsh_hash(query), config), current, results)) return true;
+        misses++;
+        return false;
+    }
+
+    void insert(const float* query, uint64_t config, const int* results, uint64_t cost_ns) {
+        uint64_t exact_key = mix(exact_hash(query), config);
+        uint64_t lsh_key = near_threshold > 0 ? mix(lsh_hash(query), config) : 0;
+        shard_t& shard = shard_of(exact_key);
+        int shard_id = static_cast<int>(&shard - shards.data());
+
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto it = shard.exact_index.find(exact_key);
+        int slot = it != shard.exact_index.end() ? it->second : -1;
+        if (slot >= 0) {
+            remove(shard, slot);
+        } else {
+            slot = evict(shard);
+        }
+
+        shard.entries[slot] = entry_t{exact_key, lsh_key, config, epoch.load(std::memory_order_acquire), cost_ns, true, false};
+        memcpy(&shard.queries[static_cast<size_t>(slot) * vector_dim], query, vector_dim * sizeof(float));
+        memcpy(&shard.results[static_cast<size_t>(slot) * k], results, k * sizeof(int));
+        shard.exact_index[exact_key] = slot;
+        if (near_threshold > 0) {
+            lsh_shard_t& lsh = lsh_shard_of(lsh_key);
+            std::lock_guard<std::mutex> lsh_guard(lsh.lock);
+            lsh.index.insert(std::make_pair(lsh_key, lsh_ref_t{shard_id, slot}));
+        }
+    }
+
+    // Call after any change to the index; cached results become misses
+    void invalidate() {
+        epoch.fetch_add(1, std::memory_order_release);
+    }
+
+    int get_k() const {
+        return k;
+    }
+
+    uint64_t get_exact_hits() const {
+        return exact_hits.load();
+    }
+
+    uint64_t get_near_hits() const {
+        return near_hits.load();
+    }
+
+    uint64_t get_misses() const {
+        return misses.load();
+    }
+
+    double get_hit_rate() const {
+        uint64_t hits = exact_hits.load() + near_hits.load();
+        uint64_t total = hits + misses.load();
+        return total > 0 ? static_cast<double>(hits) / total : 0.0;
+    }
+
+    // Sum of the original search times of every query answered from the cache
+    double get_saved_ms() const {
+        return saved_ns.load() / 1e6;
+    }
+};
@@ -30,7 +30,7 @@ public:
                     int gt_id = gt[i * gt_k + j];
                     if (predict_id == gt_id) {
                         ++correct_count;
-                    } else {
+                    } else if (predict_id >= 0) { // -1 pads short result lists
                         const float* predict_vec = base + predict_id * vector_dim;
                         const float* gt_vec = base + gt_id * vector_dim;
                         const float* query_vec = query + i * vector_dim;
@@ -54,7 +54,7 @@ public:
                     int gt_id = gt[i * gt_k + j];
                     if (predict_id == gt_id) {
                         ++correct_count;
-                    } else {
+                    } else if (predict_id >= 0) { // -1 pads short result lists
                         const float* predict_vec = base + predict_id * vector_dim;
                         const float* gt_vec = base + gt_id * vector_dim;
                         const float* query_vec = query + i * vector_dim;
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "distance.hpp"
+#include "pqueue.hpp"
+#include "search_context.hpp"
+#include "uring.hpp"
+
+#include <omp.h>
+
+// Second search stage: re-scores the top R candidates of an approximate
+// search against full precision vectors that stay on disk. Only the candidate
+// rows of each query are read, as one batch through a SectorReader, so R
+// trades I/O for recall. Rows are neither sector sized nor sector aligned in
+// an .fvecs file, so the file is read through the page cache, not O_DIRECT.
+class Reranker {
+private:
+    std::string filename;
+    int fd = -1;
+    size_t file_size = 0;
+
+    int vector_dim = 0;
+    int num_vectors = 0;
+    size_t row_stride = 0;    // 4 byte dim header + vector
+    size_t row_floats = 0;    // vector padded to 32 bytes in the read buffer
+
+    double runtime = 0.0;
+
+    static constexpr unsigned READ_DEPTH = 64;
+
+    off_t row_offset(int id) const {
+        return static_cast<off_t>(static_cast<size_t>(id) * row_stride + sizeof(int));
+    }
+
+public:
+    Reranker(const std::string& file) : filename(file) {
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return;
+        }
+
+        struct stat st;
+        int dim = 0;
+        if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(int)) ||
+            pread(fd, &dim, sizeof(int), 0) != static_cast<ssize_t>(sizeof(int))) {
+            std::cerr << "Error reading file: " << filename << std::endl;
+            return;
+        }
+        file_size = st.st_size;
+
+        size_t stride = sizeof(int) + static_cast<size_t>(std::max(dim, 0)) * sizeof(float);
+        if (dim <= 0 || file_size % stride != 0) {
+            std::cerr << "Not an fvecs file: " << filename << " (dim " << dim << ", " << file_size << " bytes)" << std::endl;
+            return;
+        }
+        vector_dim = dim;
+        row_stride = stride;
+        row_floats = (static_cast<size_t>(vector_dim) + 7) / 8 * 8;
+        num_vectors = static_cast<int>(file_size / row_stride);
+    }
+
+    ~Reranker() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool ok() const {
+        return num_vectors > 0;
+    }
+
+    // candidates: num_queries * R ids from any approximate search (-1 padded).
+    // results: num_queries * k ids by exact distance, -1 padded. Fails, with
+    // results all -1, if the file didn't load or query_dim doesn't match it.
+    bool rerank(const float* query_vecs, int query_dim, int num_queries, const int* candidates, int R, int k, int* results) {
+        if (!ok() || query_dim != vector_dim) {
+            std::cerr << "Query dim " << query_dim << " does not match " << filename << " (dim " << vector_dim << ")" << std::endl;
+            std::fill(results, results + static_cast<size_t>(num_queries) * k, -1);
+            return false;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        bool all_read = true;
+
+        #pragma omp parallel reduction(&& : all_read)
+        {
+            // Rows land 32 byte aligned for compute_distance_squared. Ring and
+            // buffers live in the thread's context across batches.
+            SearchContext& ctx = thread_search_context();
+            SectorReader& reader = ctx.reader(fd, READ_DEPTH);
+            float* rows = reinterpret_cast<float*>(ctx.io_buffer(std::max(R, 1) * row_floats * sizeof(float)));
+            std::vector<read_req_t>& reqs = ctx.reads;
+            int* ids = ctx.ints(R);
+
+            #pragma omp for schedule(dynamic, 1)
+            for (int i = 0; i < num_queries; ++i) {
+                const float* query_ptr = query_vecs + static_cast<size_t>(i) * vector_dim;
+                int* out = results + static_cast<size_t>(i) * k;
+
+                // file order keeps the batch's offsets ascending for the device
+                int count = 0;
+                const int* cand = candidates + static_cast<size_t>(i) * R;
+                for (int r = 0; r < R; ++r) {
+                    if (cand[r] >= 0 && cand[r] < num_vectors) ids[count++] = cand[r];
+                }
+                std::sort(ids, ids + count);
+
+                reqs.clear();
+                for (int r = 0; r < count; ++r) {
+                    reqs.push_back({rows + r * row_floats, vector_dim * sizeof(float), row_offset(ids[r])});
+                }
+                if (!reader.read(reqs)) {
+                    std::cerr << "Error reading rows from " << filename << std::endl;
+                    std::fill(out, out + k, -1);
+                    all_read = false;
+                    continue;
+                }
+
+                pqueue_t<int>& S = ctx.results;
+                S.reset(k);
+                for (int r = 0; r < count; ++r) {
+                    S.push(ids[r], compute_distance_squared(vector_dim, query_ptr, rows + r * row_floats));
+                }
+                for (int m = 0; m < k; ++m) {
+                    out[m] = m < S.size() ? S[m] : -1;
+                }
+            }
+        }
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        return all_read;
+    }
+
+    int get_vector_dim() const {
+        return vector_dim;
+    }
+
+    int get_num_vectors() const {
+        return num_vectors;
+    }
+
+    double get_runtime() const {
+        return runtime;
+    }
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <numeric>
+#include <algorithm>
+
+#include <omp.h>
+
+// One slice of one query's work: points [begin, end) of an inverted list
+struct list_task_t {
+    int query;
+    int list;
+    int begin;
+    int end;
+};
+
+// Splits every probed list into chunks of at most grain points, so no task
+// costs more than grain distance computations. probes holds knn_cluster list
+// ids per query (-1 for none). Tasks come out grouped by query and
+// task_begin[q] .. task_begin[q + 1] are query q's tasks.
+inline void split_list_tasks(const std::vector<std::vector<int>>& ivf, const std::vector<int>& probes,
+                             int num_queries, int knn_cluster, int grain,
+                             std::vector<list_task_t>& tasks, std::vector<int>& task_begin) {
+    tasks.clear();
+    task_begin.assign(num_queries + 1, 0);
+    for (int q = 0; q < num_queries; ++q) {
+        task_begin[q] = static_cast<int>(tasks.size());
+        for (int s = 0; s < knn_cluster; ++s) {
+            int list = probes[static_cast<size_t>(q) * knn_cluster + s];
+            if (list < 0) continue;
+            int size = static_cast<int>(ivf[list].size());
+            for (int begin = 0; begin < size; begin += grain) {
+                tasks.push_back(list_task_t{q, list, begin, std::min(size, begin + grain)});
+            }
+        }
+    }
+    task_begin[num_queries] = static_cast<int>(tasks.size());
+}
+
+// Work-stealing pool over the OpenMP team. Tasks are dealt largest first to
+// the least loaded worker (LPT). A worker pops from the front of its own queue
+// and, once that is empty, steals from the back of the others, so the large
+// tasks start early and the small ones fill the gaps at the end. Queues keep
+// their capacity, so a pool that is reused across batches doesn't allocate.
+class WorkStealingPool {
+private:
+    struct worker_queue_t {
+        std::mutex lock;
+        std::vector<int> tasks;
+        size_t head = 0;          // tasks[head, size) are still queued
+    };
+
+    std::vector<worker_queue_t> queues;
+    std::vector<int> order;
+    std::vector<long> load;
+
+    bool pop(int worker, int& task) {
+        {
+            worker_queue_t& own = queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (own.head < own.tasks.size()) {
+                task = own.tasks[own.head++];
+                return true;
+            }
+        }
+        int num_workers = static_cast<int>(queues.size());
+        for (int v = 1; v < num_workers; ++v) {
+            worker_queue_t& victim = queues[(worker + v) % num_workers];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.head < victim.tasks.size()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    WorkStealingPool(int num_workers = omp_get_max_threads()) : queues(std::max(1, num_workers)) {}
+
+    // costs[t] is the estimated cost of task t
+    void assign(const std::vector<long>& costs) {
+        order.resize(costs.size());
+        std::iota(order.begin(), order.end(), 0);
+        // ties by index keep the order stable without stable_sort's buffer
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return costs[a] > costs[b] || (costs[a] == costs[b] && a < b);
+        });
+
+        load.assign(queues.size(), 0);
+        for (worker_queue_t& q : queues) {
+            q.tasks.clear();
+            q.head = 0;
+        }
+        for (int t : order) {
+            size_t w = std::min_element(load.begin(), load.end()) - load.begin();
+            queues[w].tasks.push_back(t);
+            load[w] += costs[t];
+        }
+    }
+
+    // Runs fn(task) for every assigned task on the OpenMP team
+    template <typename Fn>
+    void run(Fn fn) {
+        int num_workers = static_cast<int>(queues.size());
+        #pragma omp parallel num_threads(num_workers)
+        {
+            int worker = omp_get_thread_num();
+            int task;
+            while (pop(worker, task)) fn(task);
+        }
+    }
+
+    int get_num_workers() const {
+        return static_cast<int>(queues.size());
+    }
+};
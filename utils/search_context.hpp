@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <stdint.h>
+
+#include "pqueue.hpp"
+#include "uring.hpp"
+
+// Open addressing set of vertex ids for graph traversals. Every slot is
+// stamped with the generation that wrote it, so clear() only bumps the
+// generation and the table is zeroed only when the stamp wraps. Once it has
+// grown to a query's working set a search never allocates.
+class VisitedSet {
+private:
+    std::vector<uint64_t> slots;  // generation << 32 | id, stale generations are empty
+    size_t mask = 0;
+    size_t count = 0;
+    uint64_t generation = 1;
+
+    void grow() {
+        std::vector<uint64_t> old;
+        old.swap(slots);
+        slots.assign(old.empty() ? 1024 : old.size() * 2, 0);
+        mask = slots.size() - 1;
+        count = 0;
+        for (uint64_t entry : old) {
+            if ((entry >> 32) == generation) insert(static_cast<uint32_t>(entry));
+        }
+    }
+
+public:
+    VisitedSet() {
+        grow();
+    }
+
+    void clear() {
+        count = 0;
+        if (++generation > UINT32_MAX) {
+            std::fill(slots.begin(), slots.end(), 0);
+            generation = 1;
+        }
+    }
+
+    // Returns false if id was already in the set
+    bool insert(uint32_t id) {
+        if (2 * (count + 1) > slots.size()) grow();
+        const uint64_t entry = generation << 32 | id;
+        size_t pos = (id * 0x9e3779b1u) & mask;
+        while ((slots[pos] >> 32) == generation) {
+            if (slots[pos] == entry) return false;
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = entry;
+        count++;
+        return true;
+    }
+};
+
+// Per thread scratch for the search paths: queues, candidate buffers and a
+// visited set that are reset between queries rather than reallocated. After
+// the first few queries have sized the buffers the search loops run without
+// touching the heap.
+struct SearchContext {
+    pqueue_t<int> clusters;       // probed IVF lists
+    pqueue_t<int> candidates;     // first stage / beam candidates
+    pqueue_t<int> results;        // final top-k
+    pqueue_t<uint32_t> frontier;  // graph search list
+    VisitedSet visited;
+
+    std::vector<float> dist_buffer;
+    std::vector<int> id_buffer;
+    std::vector<uint64_t> code_buffer;
+    std::vector<uint32_t> node_buffer;
+    std::vector<std::pair<float, int>> scored;         // batch_push input
+    std::vector<std::pair<float, uint32_t>> scored_nodes;
+    std::vector<const int*> run_ids;                   // kway_merge inputs
+    std::vector<const float*> run_dists;
+    std::vector<read_req_t> reads;                     // one batch of SectorReader requests
+
+    struct free_deleter {
+        void operator()(char* ptr) const { free(ptr); }
+    };
+    std::unique_ptr<char, free_deleter> io_bytes;
+    size_t io_capacity = 0;
+    std::unique_ptr<SectorReader> io_reader;
+    int io_fd = -1;
+    unsigned io_depth = 0;
+
+    // vector::resize never shrinks capacity, so these are free once warm
+    float* floats(size_t n) {
+        if (dist_buffer.size() < n) dist_buffer.resize(n);
+        return dist_buffer.data();
+    }
+
+    int* ints(size_t n) {
+        if (id_buffer.size() < n) id_buffer.resize(n);
+        return id_buffer.data();
+    }
+
+    uint64_t* words(size_t n) {
+        if (code_buffer.size() < n) code_buffer.resize(n);
+        return code_buffer.data();
+    }
+
+    uint32_t* nodes(size_t n) {
+        if (node_buffer.size() < n) node_buffer.resize(n);
+        return node_buffer.data();
+    }
+
+    // Sector aligned read target, which is also 32 byte aligned for the
+    // distance kernels
+    char* io_buffer(size_t bytes) {
+        if (io_capacity < bytes) {
+            size_t capacity = (bytes + 4095) / 4096 * 4096;
+            io_bytes.reset(static_cast<char*>(aligned_alloc(4096, capacity)));
+            if (!io_bytes) {
+                io_capacity = 0;
+                throw std::bad_alloc();
+            }
+            io_capacity = capacity;
+        }
+        return io_bytes.get();
+    }
+
+    // The ring is kept across batches and only set up again when a search
+    // reads another file or wants a deeper queue
+    SectorReader& reader(int fd, unsigned depth) {
+        if (!io_reader || io_fd != fd || io_depth < depth) {
+            io_reader.reset();
+            io_reader.reset(new SectorReader(fd, depth));
+            io_fd = fd;
+            io_depth = depth;
+        }
+        return *io_reader;
+    }
+};
+
+// One context per OpenMP (or any other) thread, created on first use
+inline SearchContext& thread_search_context() {
+    static thread_local SearchContext context;
+    return context;
+}
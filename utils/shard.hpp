@@ -0,0 +1,376 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <stdint.h>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+#include "anns.hpp"
+#include "distance.hpp"
+#include "pqueue.hpp"
+#include "search_context.hpp"
+
+// Wire format, host byte order (both ends run on the same machine):
+//   request:  shard_header_t, then num_queries * dim floats
+//   response: shard_header_t, then num_queries * k ids, then num_queries * k dists
+enum ShardOp : int32_t {
+    SHARD_SEARCH = 1,
+    SHARD_SHUTDOWN = 2
+};
+
+struct shard_header_t {
+    int32_t op;
+    int32_t num_queries;
+    int32_t dim;
+    int32_t k;
+};
+
+// Upper bounds a peer may ask for, so a corrupt header can't drive a huge allocation
+#define SHARD_MAX_QUERIES (1 << 20)
+#define SHARD_MAX_K (1 << 16)
+
+inline bool valid_search_header(const shard_header_t& h, int dim) {
+    return h.op == SHARD_SEARCH && h.dim == dim &&
+           h.num_queries > 0 && h.num_queries <= SHARD_MAX_QUERIES &&
+           h.k > 0 && h.k <= SHARD_MAX_K;
+}
+
+// Bounds every later send on fd, a peer that stopped reading fails the send
+inline void set_send_timeout(int fd, long timeout_ms) {
+    timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+inline bool send_all(int fd, const void* buf, size_t len) {
+    const char* ptr = static_cast<const char*>(buf);
+    while (len > 0) {
+        ssize_t n = send(fd, ptr, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
+
+inline bool recv_all(int fd, void* buf, size_t len) {
+    char* ptr = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t n = recv(fd, ptr, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
+
+inline sockaddr_un shard_address(const std::string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+// Serves k-NN over one slice of the base set on a Unix socket. Row j of the
+// slice is global id (id_offset + j). Brute force unless an IVF is attached.
+class ShardServer {
+private:
+    int vector_dim;
+    const float* data_vecs;
+    int data_size;
+    int id_offset;
+
+    const float* clusters = nullptr;
+    const std::vector<std::vector<int>>* ivf = nullptr;
+    int num_clusters = 0;
+    int knn_cluster = 0;
+
+    // Returns false when the client asked for shutdown
+    bool handle_request(int fd, const shard_header_t& req) {
+        if (req.op == SHARD_SHUTDOWN) return false;
+        if (!valid_search_header(req, vector_dim)) {
+            std::cerr << "Rejecting shard request: op " << req.op << ", " << req.num_queries << " queries, dim "
+                      << req.dim << ", k " << req.k << std::endl;
+            return true;
+        }
+
+        // ANNS requires 32-byte aligned query rows
+        size_t query_bytes = static_cast<size_t>(req.num_queries) * vector_dim * sizeof(float);
+        float* query_vecs = static_cast<float*>(aligned_alloc(32, (query_bytes + 31) & ~size_t(31)));
+        if (!query_vecs) throw std::bad_alloc();
+        if (!recv_all(fd, query_vecs, query_bytes)) {
+            free(query_vecs);
+            return true;
+        }
+
+        int k = req.k;
+        ANNS ann(vector_dim, k, query_vecs, data_vecs, req.num_queries, data_size);
+        if (ivf) {
+            ann.IVF_knn(clusters, *ivf, num_clusters, knn_cluster);
+        } else {
+            ann.brute_knn();
+        }
+
+        // ANNS only keeps ids, recompute the k distances the coordinator merges on
+        size_t num_results = static_cast<size_t>(req.num_queries) * k;
+        std::vector<int32_t> ids(num_results);
+        std::vector<float> dists(num_results);
+        const int* local_ids = ann.get_dist_lists();
+        for (int i = 0; i < req.num_queries; ++i) {
+            for (int m = 0; m < k; ++m) {
+                size_t slot = static_cast<size_t>(i) * k + m;
+                int id = local_ids[slot];
+                if (id < 0 || id >= data_size) {
+                    ids[slot] = -1;
+                    dists[slot] = FLT_MAX;
+                    continue;
+                }
+                ids[slot] = id + id_offset;
+                dists[slot] = compute_distance_squared(vector_dim, query_vecs + i * vector_dim,
+                                                       data_vecs + static_cast<size_t>(id) * vector_dim);
+            }
+        }
+        free(query_vecs);
+
+        shard_header_t resp = {SHARD_SEARCH, req.num_queries, vector_dim, k};
+        send_all(fd, &resp, sizeof(resp));
+        send_all(fd, ids.data(), num_results * sizeof(int32_t));
+        send_all(fd, dists.data(), num_results * sizeof(float));
+        return true;
+    }
+
+public:
+    ShardServer(int dim, const float* data, int dsize, int offset) :
+    vector_dim(dim), data_vecs(data), data_size(dsize), id_offset(offset) {}
+
+    void set_ivf(const float* cluster_data, const std::vector<std::vector<int>>* lists, int nclusters, int nprobe) {
+        clusters = cluster_data;
+        ivf = lists;
+        num_clusters = nclusters;
+        knn_cluster = nprobe;
+    }
+
+    // Blocks serving one coordinator connection at a time until a
+    // SHARD_SHUTDOWN request arrives.
+    void serve(const std::string& socket_path) {
+        int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            std::cerr << "Error creating socket: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        unlink(socket_path.c_str());
+        sockaddr_un addr = shard_address(socket_path);
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd, 4) < 0) {
+            std::cerr << "Error binding socket " << socket_path << ": " << strerror(errno) << std::endl;
+            close(listen_fd);
+            return;
+        }
+
+        bool running = true;
+        while (running) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            shard_header_t req;
+            while (recv_all(fd, &req, sizeof(req))) {
+                // an invalid header leaves the stream out of sync, so drop the connection
+                if (req.op != SHARD_SHUTDOWN && !valid_search_header(req, vector_dim)) {
+                    handle_request(fd, req);
+                    break;
+                }
+                if (!handle_request(fd, req)) {
+                    running = false;
+                    break;
+                }
+            }
+            close(fd);
+        }
+
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+};
+
+// Fans query batches out to every shard and k-way merges the per-shard top-k.
+// Shards that miss the timeout are left out of the result, which is then
+// flagged as partial; their connection is dropped so a late reply can't be
+// mistaken for the next batch's.
+class ShardCoordinator {
+private:
+    std::vector<std::string> socket_paths;
+    std::vector<int> fds;
+    int vector_dim;
+    int k;
+    int timeout_ms;
+
+    int num_answered = 0;
+    double runtime = 0.0;
+
+    bool connect_shard(int s) {
+        if (fds[s] >= 0) return true;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        sockaddr_un addr = shard_address(socket_paths[s]);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(fd);
+            return false;
+        }
+        fds[s] = fd;
+        return true;
+    }
+
+    void drop_shard(int s) {
+        if (fds[s] >= 0) close(fds[s]);
+        fds[s] = -1;
+    }
+
+public:
+    ShardCoordinator(const std::vector<std::string>& paths, int dim, int k_val, int timeout) :
+    socket_paths(paths), fds(paths.size(), -1), vector_dim(dim), k(k_val), timeout_ms(timeout) {}
+
+    ~ShardCoordinator() {
+        for (size_t s = 0; s < fds.size(); ++s) drop_shard(s);
+    }
+
+    // Writes num_queries * k global ids into results, -1 padded.
+    // Returns true when every shard answered in time.
+    bool search(const float* query_vecs, int num_queries, int* results) {
+        int num_shards = static_cast<int>(socket_paths.size());
+        // nothing to scatter, don't wait out the timeout on empty replies
+        if (num_queries <= 0) {
+            if (num_queries < 0) std::cerr << "Negative query count: " << num_queries << std::endl;
+            num_answered = num_queries == 0 ? num_shards : 0;
+            runtime = 0.0;
+            return num_queries == 0;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t num_results = static_cast<size_t>(num_queries) * k;
+        size_t reply_bytes = sizeof(shard_header_t) + num_results * (sizeof(int32_t) + sizeof(float));
+
+        // scatter
+        shard_header_t req = {SHARD_SEARCH, num_queries, vector_dim, k};
+        std::vector<bool> pending(num_shards, false);
+        auto deadline = start + std::chrono::milliseconds(timeout_ms);
+        for (int s = 0; s < num_shards; ++s) {
+            long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::high_resolution_clock::now()).count();
+            if (remaining <= 0) break;
+            if (!connect_shard(s)) continue;
+            set_send_timeout(fds[s], remaining);
+            if (send_all(fds[s], &req, sizeof(req)) &&
+                send_all(fds[s], query_vecs, static_cast<size_t>(num_queries) * vector_dim * sizeof(float))) {
+                pending[s] = true;
+            } else {
+                drop_shard(s);
+            }
+        }
+
+        // gather until all replies are in or the deadline passes
+        std::vector<std::vector<char>> replies(num_shards);
+        std::vector<size_t> received(num_shards, 0);
+        for (int s = 0; s < num_shards; ++s) {
+            if (pending[s]) replies[s].resize(reply_bytes);
+        }
+        while (true) {
+            std::vector<pollfd> pfds;
+            std::vector<int> owners;
+            for (int s = 0; s < num_shards; ++s) {
+                if (pending[s] && received[s] < reply_bytes) {
+                    pfds.push_back({fds[s], POLLIN, 0});
+                    owners.push_back(s);
+                }
+            }
+            if (pfds.empty()) break;
+
+            auto now = std::chrono::high_resolution_clock::now();
+            if (now >= deadline) break;
+            int wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+            int ready = poll(pfds.data(), pfds.size(), wait);
+            if (ready < 0 && errno != EINTR) break;
+
+            for (size_t p = 0; p < pfds.size(); ++p) {
+                if (!(pfds[p].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                int s = owners[p];
+                ssize_t n = recv(fds[s], replies[s].data() + received[s], reply_bytes - received[s], 0);
+                if (n > 0) {
+                    received[s] += n;
+                } else if (n == 0 || errno != EINTR) {
+                    pending[s] = false;
+                    drop_shard(s);
+                }
+            }
+        }
+
+        std::vector<int> answered;
+        for (int s = 0; s < num_shards; ++s) {
+            const shard_header_t* resp = pending[s] ? reinterpret_cast<const shard_header_t*>(replies[s].data()) : nullptr;
+            if (resp && received[s] == reply_bytes &&
+                (resp->op != SHARD_SEARCH || resp->num_queries != num_queries || resp->dim != vector_dim || resp->k != k)) {
+                std::cerr << "Shard " << s << " replied for a different request, dropping it" << std::endl;
+                drop_shard(s);
+            } else if (pending[s] && received[s] == reply_bytes) {
+                answered.push_back(s);
+            } else if (pending[s]) {
+                drop_shard(s); // timed out
+            }
+        }
+        num_answered = static_cast<int>(answered.size());
+
+        // merge
+        #pragma omp parallel for
+        for (int i = 0; i < num_queries; ++i) {
+            SearchContext& ctx = thread_search_context();
+            ctx.run_ids.clear();
+            ctx.run_dists.clear();
+            for (int s : answered) {
+                const char* body = replies[s].data() + sizeof(shard_header_t);
+                const int32_t* ids = reinterpret_cast<const int32_t*>(body);
+                const float* dists = reinterpret_cast<const float*>(body + num_results * sizeof(int32_t));
+                ctx.run_ids.push_back(ids + static_cast<size_t>(i) * k);
+                ctx.run_dists.push_back(dists + static_cast<size_t>(i) * k);
+            }
+
+            int* out = results + static_cast<size_t>(i) * k;
+            float* merged = ctx.floats(k);
+            int found = kway_merge(ctx.run_ids, ctx.run_dists, k, k, out, merged);
+            std::fill(out + found, out + k, -1);
+        }
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        runtime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        return num_answered == num_shards;
+    }
+
+    void shutdown_shards() {
+        shard_header_t req = {SHARD_SHUTDOWN, 0, vector_dim, 0};
+        for (size_t s = 0; s < socket_paths.size(); ++s) {
+            if (connect_shard(s)) send_all(fds[s], &req, sizeof(req));
+            drop_shard(s);
+        }
+    }
+
+    int get_num_answered() const {
+        return num_answered;
+    }
+
+    double get_runtime() const {
+        return runtime;
+    }
+};
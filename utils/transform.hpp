@@ -0,0 +1,332 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+#include "distance.hpp"
+#include "pq.hpp"
+
+#include <omp.h>
+#include <immintrin.h>
+
+// Eigen decomposition of a symmetric n x n matrix (row major, destroyed) by
+// cyclic Jacobi rotations. Column j of vecs is the eigenvector of vals[j].
+inline void jacobi_eigen(std::vector<double>& a, int n, std::vector<double>& vals, std::vector<double>& vecs) {
+    vecs.assign(static_cast<size_t>(n) * n, 0.0);
+    for (int i = 0; i < n; ++i) vecs[static_cast<size_t>(i) * n + i] = 1.0;
+
+    for (int sweep = 0; sweep < 100; ++sweep) {
+        double off = 0.0, total = 0.0;
+        for (int p = 0; p < n; ++p) {
+            for (int q = 0; q < n; ++q) {
+                double x = a[static_cast<size_t>(p) * n + q] * a[static_cast<size_t>(p) * n + q];
+                total += x;
+                if (p != q) off += x;
+            }
+        }
+        if (off <= 1e-22 * total) break;
+
+        for (int p = 0; p < n - 1; ++p) {
+            for (int q = p + 1; q < n; ++q) {
+                double apq = a[static_cast<size_t>(p) * n + q];
+                if (std::fabs(apq) < 1e-300) continue;
+                double theta = (a[static_cast<size_t>(q) * n + q] - a[static_cast<size_t>(p) * n + p]) / (2.0 * apq);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0);
+                double s = t * c;
+
+                for (int k = 0; k < n; ++k) {
+                    double akp = a[static_cast<size_t>(k) * n + p], akq = a[static_cast<size_t>(k) * n + q];
+                    a[static_cast<size_t>(k) * n + p] = c * akp - s * akq;
+                    a[static_cast<size_t>(k) * n + q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; ++k) {
+                    double apk = a[static_cast<size_t>(p) * n + k], aqk = a[static_cast<size_t>(q) * n + k];
+                    a[static_cast<size_t>(p) * n + k] = c * apk - s * aqk;
+                    a[static_cast<size_t>(q) * n + k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; ++k) {
+                    double vkp = vecs[static_cast<size_t>(k) * n + p], vkq = vecs[static_cast<size_t>(k) * n + q];
+                    vecs[static_cast<size_t>(k) * n + p] = c * vkp - s * vkq;
+                    vecs[static_cast<size_t>(k) * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    vals.resize(n);
+    for (int i = 0; i < n; ++i) vals[i] = a[static_cast<size_t>(i) * n + i];
+}
+
+// y = A (x - mean) with A a dim_out x dim_in matrix. apply() is blocked over
+// rows so every row of A is loaded once per block of vectors, not per vector.
+// dim_out has to be a multiple of 8: transformed rows are packed dim_out
+// floats apart and compute_distance_squared needs every row 32-byte aligned.
+class LinearTransform {
+protected:
+    int dim_in;
+    int dim_out;
+    std::vector<float> matrix;   // [dim_out][dim_in]
+    std::vector<float> mean;     // [dim_in]
+
+public:
+    LinearTransform(int in, int out) : dim_in(in), dim_out(out),
+    matrix(static_cast<size_t>(out) * in, 0.0f), mean(in, 0.0f) {
+        if (dim_in <= 0 || dim_out <= 0 || dim_out % 8 != 0) {
+            std::cerr << "Transform output dim " << dim_out << " is not a positive multiple of 8, "
+                      << "transformed rows would not stay 32-byte aligned" << std::endl;
+            throw std::invalid_argument("LinearTransform: dim_out must be a positive multiple of 8");
+        }
+        for (int i = 0; i < std::min(in, out); ++i) matrix[static_cast<size_t>(i) * dim_in + i] = 1.0f;
+    }
+
+    // in: num_vectors * dim_in, out: num_vectors * dim_out
+    void apply(const float* in, int num_vectors, float* out) const {
+        const int block = 16;
+        int num_blocks = (num_vectors + block - 1) / block;
+
+        #pragma omp parallel
+        {
+            std::vector<float> centred(static_cast<size_t>(block) * dim_in);
+
+            #pragma omp for schedule(dynamic, 1)
+            for (int b = 0; b < num_blocks; ++b) {
+                int first = b * block;
+                int count = std::min(block, num_vectors - first);
+                for (int r = 0; r < count; ++r) {
+                    const float* x = in + static_cast<size_t>(first + r) * dim_in;
+                    for (int j = 0; j < dim_in; ++j) centred[static_cast<size_t>(r) * dim_in + j] = x[j] - mean[j];
+                }
+
+                for (int o = 0; o < dim_out; ++o) {
+                    const float* row = &matrix[static_cast<size_t>(o) * dim_in];
+                    for (int r = 0; r < count; ++r) {
+                        const float* x = &centred[static_cast<size_t>(r) * dim_in];
+                        __m256 sum = _mm256_setzero_ps();
+                        int j = 0;
+                        for (; j + 8 <= dim_in; j += 8) {
+                            sum = _mm256_fmadd_ps(_mm256_loadu_ps(row + j), _mm256_loadu_ps(x + j), sum);
+                        }
+                        float dot = _mm256_reduce_add_ps(sum);
+                        for (; j < dim_in; ++j) dot += row[j] * x[j];
+                        out[static_cast<size_t>(first + r) * dim_out + o] = dot;
+                    }
+                }
+            }
+        }
+    }
+
+    int get_dim_in() const {
+        return dim_in;
+    }
+
+    int get_dim_out() const {
+        return dim_out;
+    }
+};
+
+// PCA: centres on the training mean and projects on the dim_out principal
+// axes, ordered by decreasing variance. dim_out < dim_in drops the low
+// energy dimensions, which cuts memory and per-distance FLOPs.
+class PCATransform : public LinearTransform {
+private:
+    double explained = 0.0;
+
+public:
+    PCATransform(int in, int out) : LinearTransform(in, out) {}
+
+    // Returns false, leaving the identity in place, when there is nothing to fit
+    bool train(const float* data, int num_points, int sample_size = 100000) {
+        int num_samples = std::min(num_points, sample_size);
+        if (num_samples <= 0) {
+            std::cerr << "PCA needs at least one training vector" << std::endl;
+            return false;
+        }
+        std::vector<double> mu(dim_in, 0.0);
+        for (int i = 0; i < num_samples; ++i) {
+            const float* x = data + (static_cast<size_t>(i) * num_points / num_samples) * dim_in;
+            for (int j = 0; j < dim_in; ++j) mu[j] += x[j];
+        }
+        for (int j = 0; j < dim_in; ++j) {
+            mu[j] /= num_samples;
+            mean[j] = static_cast<float>(mu[j]);
+        }
+
+        std::vector<double> cov(static_cast<size_t>(dim_in) * dim_in, 0.0);
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int p = 0; p < dim_in; ++p) {
+            for (int i = 0; i < num_samples; ++i) {
+                const float* x = data + (static_cast<size_t>(i) * num_points / num_samples) * dim_in;
+                double xp = x[p] - mu[p];
+                for (int q = p; q < dim_in; ++q) cov[static_cast<size_t>(p) * dim_in + q] += xp * (x[q] - mu[q]);
+            }
+        }
+        for (int p = 0; p < dim_in; ++p) {
+            for (int q = p; q < dim_in; ++q) {
+                cov[static_cast<size_t>(p) * dim_in + q] /= num_samples;
+                cov[static_cast<size_t>(q) * dim_in + p] = cov[static_cast<size_t>(p) * dim_in + q];
+            }
+        }
+
+        std::vector<double> vals, vecs;
+        jacobi_eigen(cov, dim_in, vals, vecs);
+        std::vector<int> order(dim_in);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int x, int y) { return vals[x] > vals[y]; });
+
+        double kept = 0.0, total = 0.0;
+        for (int i = 0; i < dim_in; ++i) total += std::max(vals[i], 0.0);
+        for (int o = 0; o < dim_out; ++o) {
+            int axis = order[o];
+            kept += std::max(vals[axis], 0.0);
+            for (int j = 0; j < dim_in; ++j) {
+                matrix[static_cast<size_t>(o) * dim_in + j] = static_cast<float>(vecs[static_cast<size_t>(j) * dim_in + axis]);
+            }
+        }
+        explained = total > 0 ? kept / total : 0.0;
+        return true;
+    }
+
+    // Fraction of the training variance kept by the dim_out axes
+    double get_explained_variance() const {
+        return explained;
+    }
+};
+
+// OPQ rotation for PQ indexes: alternates training a PQ on the rotated data
+// with the orthogonal Procrustes update of the rotation, so that the PQ
+// sub-spaces line up with the data. The PQ used afterwards should be trained
+// on apply()'d vectors with the same number of sub-spaces.
+class OPQTransform : public LinearTransform {
+public:
+    OPQTransform(int dim) : LinearTransform(dim, dim) {}
+
+    bool train(const float* data, int num_points, int num_subspaces, int iterations = 4, int sample_size = 10000) {
+        int n = std::min(num_points, sample_size);
+        int d = dim_in;
+        if (n <= 0) {
+            std::cerr << "OPQ needs at least one training vector" << std::endl;
+            return false;
+        }
+        float* sample = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(n) * d * sizeof(float)));
+        float* rotated = static_cast<float*>(aligned_alloc(32, static_cast<size_t>(n) * d * sizeof(float)));
+        if (!sample || !rotated) throw std::bad_alloc();
+        for (int i = 0; i < n; ++i) {
+            std::memcpy(sample + static_cast<size_t>(i) * d, data + (static_cast<size_t>(i) * num_points / n) * d, d * sizeof(float));
+        }
+        std::vector<uint8_t> codes(static_cast<size_t>(n) * num_subspaces);
+        std::vector<float> decoded(static_cast<size_t>(n) * d);
+
+        for (int iter = 0; iter < iterations; ++iter) {
+            apply(sample, n, rotated);
+            ProductQuantizer pq(d, num_subspaces);
+            pq.train(rotated, n, n, 10);
+            pq.encode(rotated, n, codes.data());
+            pq.decode(codes.data(), n, decoded.data());
+
+            // M = sum_i y_i x_i^T = U S V^T, best rotation is U V^T
+            std::vector<double> M(static_cast<size_t>(d) * d, 0.0);
+            #pragma omp parallel for
+            for (int p = 0; p < d; ++p) {
+                for (int i = 0; i < n; ++i) {
+                    double y = decoded[static_cast<size_t>(i) * d + p];
+                    const float* x = sample + static_cast<size_t>(i) * d;
+                    for (int q = 0; q < d; ++q) M[static_cast<size_t>(p) * d + q] += y * x[q];
+                }
+            }
+
+            // V and S^2 from M^T M, then U = M V S^-1
+            std::vector<double> MtM(static_cast<size_t>(d) * d, 0.0);
+            for (int p = 0; p < d; ++p) {
+                for (int q = 0; q < d; ++q) {
+                    double sum = 0;
+                    for (int r = 0; r < d; ++r) sum += M[static_cast<size_t>(r) * d + p] * M[static_cast<size_t>(r) * d + q];
+                    MtM[static_cast<size_t>(p) * d + q] = sum;
+                }
+            }
+            std::vector<double> vals, V;
+            jacobi_eigen(MtM, d, vals, V);
+
+            std::vector<double> U(static_cast<size_t>(d) * d, 0.0);
+            for (int c = 0; c < d; ++c) {
+                for (int r = 0; r < d; ++r) {
+                    double sum = 0;
+                    for (int j = 0; j < d; ++j) sum += M[static_cast<size_t>(r) * d + j] * V[static_cast<size_t>(j) * d + c];
+                    U[static_cast<size_t>(r) * d + c] = sum;
+                }
+                // Gram-Schmidt keeps U orthonormal even for tiny singular values
+                for (int prev = 0; prev < c; ++prev) {
+                    double dot = 0;
+                    for (int r = 0; r < d; ++r) dot += U[static_cast<size_t>(r) * d + c] * U[static_cast<size_t>(r) * d + prev];
+                    for (int r = 0; r < d; ++r) U[static_cast<size_t>(r) * d + c] -= dot * U[static_cast<size_t>(r) * d + prev];
+                }
+                double norm = 0;
+                for (int r = 0; r < d; ++r) norm += U[static_cast<size_t>(r) * d + c] * U[static_cast<size_t>(r) * d + c];
+                norm = std::sqrt(norm);
+                if (norm < 1e-12) {
+                    // degenerate column, fall back to the right singular vector
+                    for (int r = 0; r < d; ++r) U[static_cast<size_t>(r) * d + c] = V[static_cast<size_t>(r) * d + c];
+                    continue;
+                }
+                for (int r = 0; r < d; ++r) U[static_cast<size_t>(r) * d + c] /= norm;
+            }
+
+            for (int p = 0; p < d; ++p) {
+                for (int q = 0; q < d; ++q) {
+                    double sum = 0;
+                    for (int c = 0; c < d; ++c) sum += U[static_cast<size_t>(p) * d + c] * V[static_cast<size_t>(q) * d + c];
+                    matrix[static_cast<size_t>(p) * d + q] = static_cast<float>(sum);
+                }
+            }
+        }
+
+        free(sample);
+        free(rotated);
+        return true;
+    }
+};
+
+// Owns a transformed copy of a vector set, 32-byte aligned like GraphData so
+// the result can go straight into KMeans and ANNS
+class TransformedSet {
+private:
+    int vector_dim;
+    int num_vectors;
+    float* data_vecs = nullptr;
+
+public:
+    TransformedSet(const LinearTransform& transform, const float* data, int num) :
+    vector_dim(transform.get_dim_out()), num_vectors(num) {
+        data_vecs = static_cast<float*>(aligned_alloc(32, std::max<size_t>(1, static_cast<size_t>(num_vectors) * vector_dim) * sizeof(float)));
+        if (!data_vecs) throw std::bad_alloc();
+        transform.apply(data, num_vectors, data_vecs);
+    }
+
+    ~TransformedSet() {
+        free(data_vecs);
+    }
+
+    TransformedSet(const TransformedSet&) = delete;
+    TransformedSet& operator=(const TransformedSet&) = delete;
+
+    float* get_data() {
+        return data_vecs;
+    }
+
+    int get_vector_dim() const {
+        return vector_dim;
+    }
+
+    int get_num_vectors() const {
+        return num_vectors;
+    }
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct read_req_t {
+    void* buf;
+    size_t len;
+    off_t offset;
+};
+
+// Batched positional reads on one file through a private io_uring, driven by
+// raw syscalls so no liburing is needed. One reader per thread. If the ring
+// can't be set up (old kernel, seccomp), or the kernel rejects IORING_OP_READ
+// (before 5.6), it falls back to plain pread.
+class SectorReader {
+private:
+    int file_fd;
+    int ring_fd = -1;
+    unsigned depth = 0;
+
+    void* sq_ptr = nullptr;
+    size_t sq_len = 0;
+    void* cq_ptr = nullptr;
+    size_t cq_len = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_len = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    bool setup(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+
+        sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) sq_len = cq_len = std::max(sq_len, cq_len);
+
+        sq_ptr = mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        if (single_mmap) {
+            cq_ptr = sq_ptr;
+        } else {
+            cq_ptr = mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq_ptr == MAP_FAILED) {
+                munmap(sq_ptr, sq_len);
+                close(fd);
+                return false;
+            }
+        }
+
+        sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqe_ptr = mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqe_ptr == MAP_FAILED) {
+            if (cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+            munmap(sq_ptr, sq_len);
+            close(fd);
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqe_ptr);
+
+        char* sq = static_cast<char*>(sq_ptr);
+        char* cq = static_cast<char*>(cq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        ring_fd = fd;
+        depth = params.sq_entries;
+        return true;
+    }
+
+    void teardown() {
+        if (ring_fd < 0) return;
+        munmap(sqes, sqes_len);
+        if (cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+        munmap(sq_ptr, sq_len);
+        close(ring_fd);
+        ring_fd = -1;
+    }
+
+    static bool read_pread(int fd, const read_req_t* reqs, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (pread(fd, reqs[i].buf, reqs[i].len, reqs[i].offset) != static_cast<ssize_t>(reqs[i].len)) return false;
+        }
+        return true;
+    }
+
+    // Every read the kernel took is reaped before returning, even after an
+    // error, so no completion lands in a later batch or a reused buffer.
+    // unusable is set if the ring itself failed or can't do IORING_OP_READ.
+    bool read_ring(const read_req_t* reqs, unsigned count, bool& unusable) {
+        unsigned first = *sq_tail;
+        unsigned tail = first;
+        for (unsigned i = 0; i < count; ++i) {
+            unsigned idx = tail & *sq_mask;
+            io_uring_sqe* sqe = &sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = file_fd;
+            sqe->addr = reinterpret_cast<uint64_t>(reqs[i].buf);
+            sqe->len = static_cast<uint32_t>(reqs[i].len);
+            sqe->off = reqs[i].offset;
+            sqe->user_data = i;
+            sq_array[idx] = idx;
+            tail++;
+        }
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+        unsigned to_submit = count;
+        unsigned expected = count;
+        unsigned done = 0;
+        bool ok = true;
+        while (done < expected) {
+            int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, expected - done,
+                                               IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                ok = false;
+                unusable = true;
+                // can't even wait, the ring is closed by the caller
+                if (to_submit == 0) break;
+                // withdraw what the kernel didn't take, then wait for the rest
+                unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+                __atomic_store_n(sq_tail, head, __ATOMIC_RELEASE);
+                expected = head - first;
+                to_submit = 0;
+                continue;
+            }
+            to_submit -= std::min(to_submit, static_cast<unsigned>(ret));
+
+            unsigned head = *cq_head;
+            unsigned ctail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            while (head != ctail) {
+                const io_uring_cqe& cqe = cqes[head & *cq_mask];
+                if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) unusable = true;
+                // short reads only happen past EOF, i.e. a corrupt index
+                if (cqe.res < 0 || static_cast<size_t>(cqe.res) != reqs[cqe.user_data].len) ok = false;
+                head++;
+                done++;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+        return ok;
+    }
+
+public:
+    SectorReader(int fd, unsigned entries) : file_fd(fd) {
+        setup(entries);
+    }
+
+    ~SectorReader() {
+        teardown();
+    }
+
+    SectorReader(const SectorReader&) = delete;
+    SectorReader& operator=(const SectorReader&) = delete;
+
+    // Issues every read at once and blocks until all have completed
+    bool read(const std::vector<read_req_t>& reqs) {
+        bool ok = true;
+        for (size_t i = 0; i < reqs.size(); i += depth) {
+            unsigned count = static_cast<unsigned>(std::min<size_t>(depth ? depth : reqs.size(), reqs.size() - i));
+            if (ring_fd < 0) {
+                ok = read_pread(file_fd, reqs.data() + i, count) && ok;
+                continue;
+            }
+            bool unusable = false;
+            bool batch_ok = read_ring(reqs.data() + i, count, unusable);
+            if (unusable) {
+                // reads are idempotent, so the whole batch is redone with pread
+                teardown();
+                batch_ok = read_pread(file_fd, reqs.data() + i, count);
+            }
+            ok = batch_ok && ok;
+        }
+        return ok;
+    }
+
+    bool uses_uring() const {
+        return ring_fd >= 0;
+    }
+};